@@ -3,7 +3,6 @@
 
 import sys
 import pandas as pd
-import geopandas as gpd
 from collections import OrderedDict
 from copy import deepcopy
 import json
@@ -33,6 +32,7 @@ area_id_clean_csv  = area_id.upper()
 adj_csv            = input_area + "_" + area_id.lower() + "_adjacency.csv"
 clean_csv          = input_area + "_" + area_id.lower() + "_clean.csv"
 gpkg_file          = input_area + "_" + area_id.lower() + ".gpkg"
+corr_csv           = input_area + "_" + area_id.lower() + "_correlations.csv"
 
 progress = 0
 
@@ -60,7 +60,15 @@ def get_boundary_length(gdf, id1):
 
 df     = pd.read_csv(cadmium_dir + clean_csv)   # General information (id, population, area...)
 df_adj = pd.read_csv(cadmium_dir + adj_csv)     # Pair of adjacent territories
-gdf    = gpd.read_file(cadmium_dir + gpkg_file) # GeoDataFrame with the territories poligons
+
+# The correlations written by precomputeCorrelations.py, or else the GeoDataFrame with the territories poligons
+correlations = None
+if os.path.isfile(cadmium_dir + corr_csv):
+    df_corr      = pd.read_csv(cadmium_dir + corr_csv, float_precision="round_trip")
+    correlations = {(str(r), str(n)): c for r, n, c in zip(df_corr["region_id"], df_corr["neighbor_id"], df_corr["correlation"])}
+else:
+    import geopandas as gpd
+    gdf = gpd.read_file(cadmium_dir + gpkg_file)
 
 # Read default state from input json
 default_cell  = json.loads( open(input_dir + "/default.json", "r").read()      )
@@ -103,7 +111,10 @@ for ind, row, in df_adj.iterrows():
 
     # l1, l2, shared  = shared_boundaries(gdf, row_region_id, row_neighborhood_id)
     # correlation     = (shared/l1 + shared/l2) / 2  # Equation extracted from Zhong paper (boundaries only, we don't have roads info for now)
-    correlation = distance_correlation(gdf, row_region_id, row_neighborhood_id)
+    if correlations is not None:
+        correlation = correlations[(row_region_id_str, row_neighborhood_id_str)]
+    else:
+        correlation = distance_correlation(gdf, row_region_id, row_neighborhood_id)
 
     expr = {"correlation": correlation, "infection_correction_factors": default_correction_factors}
     adj_full[row_region_id_str][row_region_id_str]["neighborhood"][row_neighborhood_id_str]=expr
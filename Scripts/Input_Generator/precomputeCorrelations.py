@@ -0,0 +1,64 @@
+# Writes the correlation of every pair of regions of the adjacency file of an area to <area>_<id>_correlations.csv,
+# computed as generateScenario.py does, so that the model can be run on the input directory directly instead of on a
+# generated scenario. The adjacency file is left as it is
+
+import sys
+import json
+import pandas as pd
+import geopandas as gpd
+
+if (len(sys.argv) < 2):
+    print("\033[33mprecomputeCorrelations -- Usage")
+    print(" \033[36m$ python3 precomputeCorrelations.py <input directory> <-np>\033[33m")
+    print(" where \033[3m<input directory>\033[0;33m holds the default.json of the area (ex: \033[1minput_world\033[0;33m)")
+    print(" and \033[3m<-np>\033[0;33m turns the progress updates off\033[0m")
+    sys.exit(-1)
+#if
+
+no_progress = len(sys.argv) > 2 and sys.argv[2] == "-np"
+
+input_dir          = str(sys.argv[1])
+input_area         = json.loads( open(input_dir + "/default.json", "r").read() )["default"]["area"]
+cadmium_dir        = "../../cadmium_gis/" + input_area + "/"
+area_specific_data = json.loads( open(cadmium_dir + "generatorData.json", "r").read() )
+area_id            = area_specific_data["area_id"]
+progress_freq      = area_specific_data["progress_freq"]
+adj_csv            = input_area + "_" + area_id.lower() + "_adjacency.csv"
+corr_csv           = input_area + "_" + area_id.lower() + "_correlations.csv"
+gpkg_file          = input_area + "_" + area_id.lower() + ".gpkg"
+
+def shared_boundaries(g1, g2):
+    shared = g1.boundary.intersection(g2.boundary).length
+    return (shared/g1.length + shared/g2.length) / 2
+#shared_boundaries()
+
+def distance_correlation(g1, g2):
+    dist = g1.boundary.distance(g2.boundary)
+    if(dist==0):
+        return shared_boundaries(g1, g2)
+    return 1e5/dist
+#distance_correlation()
+
+df_adj = pd.read_csv(cadmium_dir + adj_csv)
+gdf    = gpd.read_file(cadmium_dir + gpkg_file)
+
+# The first geometry of every region, as generateScenario.py picks it
+geometries = {}
+for region, geometry in zip(gdf[area_id], gdf.geometry):
+    geometries.setdefault(str(region), geometry)
+
+correlations = []
+for ind, row in df_adj.iterrows():
+    correlations.append(distance_correlation(geometries[str(row["region_id"])], geometries[str(row["neighbor_id"])]))
+    if not(no_progress) and ind % progress_freq == 0:
+        sys.stdout.write("\r\033[33m" + str((int)(100*ind/len(df_adj))) + "%" + "\033[0m")
+#for
+
+df_corr = df_adj[["region_id", "neighbor_id"]].copy()
+df_corr["correlation"] = correlations
+df_corr.to_csv(cadmium_dir + corr_csv, index=False)
+
+if not(no_progress):
+    sys.stdout.write("\r\033[32m100%" + "\033[0m\n")
+else:
+    print("\033[32mDone.\033[0m")
@@ -0,0 +1,77 @@
+# Compares the state logs (pandemic_state.txt) of two runs of the same scenario
+# and reports the maximum deviation of every field, e.g., a float32 build against a double build
+
+import re, sys
+
+FIELDS = ["population", "susceptible", "exposed", "vaccinatedD1", "vaccinatedD2", "infected",
+          "recovered", "new_exposed", "new_infected", "new_recovered", "deaths"]
+
+regex_model_id = "_\w+"
+regex_state    = "<.+>"
+
+def usage():
+    print("\033[33mcompare_states -- Usage")
+    print(" \033[36m$ python3 compare_states.py <reference state log> <state log> [--tolerance=<max deviation>]\033[0m")
+    print(" where the reference is usually the log of a double precision build")
+    sys.exit(-1)
+
+def read_states(log_filename):
+    """ Returns {(time, cell id): [fields...]} """
+    states    = {}
+    curr_time = None
+
+    with open(log_filename, "r") as log_file:
+        for line in log_file:
+            line = line.strip()
+
+            if line.replace(".", "", 1).isnumeric():
+                curr_time = line
+                continue
+
+            state_match = re.search(regex_state, line)
+            id_match    = re.search(regex_model_id, line)
+            if not (state_match and id_match):
+                continue
+
+            cid = id_match.group().lstrip('_')
+            states[(curr_time, cid)] = list(map(float, state_match.group().strip('<>').split(',')))
+
+    return states
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        usage()
+
+    tolerance = None
+    for flag in sys.argv[3:]:
+        if flag.startswith("--tolerance=") or flag.startswith("-t="):
+            tolerance = float(flag.split("=", 1)[1])
+
+    reference = read_states(sys.argv[1])
+    compared  = read_states(sys.argv[2])
+
+    missing = set(reference.keys()) ^ set(compared.keys())
+    if missing:
+        print("\033[33m" + str(len(missing)) + " (time, cell) states are only in one of the logs\033[0m")
+
+    # Largest deviation of each field and where it happened
+    max_dev   = [0.0] * len(FIELDS)
+    where     = [None] * len(FIELDS)
+    for key in set(reference.keys()) & set(compared.keys()):
+        for i, (a, b) in enumerate(zip(reference[key], compared[key])):
+            dev = abs(a - b)
+            if dev > max_dev[i]:
+                max_dev[i] = dev
+                where[i]   = key
+
+    print("field".ljust(16) + "max deviation".ljust(20) + "(time, cell)")
+    for i, field in enumerate(FIELDS):
+        print(field.ljust(16) + ("%.6g" % max_dev[i]).ljust(20) + (str(where[i]) if where[i] else "-"))
+
+    # The population is a head count so it's not checked against the tolerance of the proportions
+    worst = max(max_dev[1:])
+    print("\nMaximum deviation of the proportions: %.6g" % worst)
+
+    if tolerance is not None and worst > tolerance:
+        print("\033[31mThe deviation is bigger then the tolerance (" + str(tolerance) + ")\033[0m")
+        sys.exit(1)
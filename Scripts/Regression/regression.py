@@ -0,0 +1,419 @@
+# Runs the model on fixed scenarios and compares the daily totals of every field of the state log
+# against golden outputs, so that an optimization that only changes the rounding can be told from one
+# that breaks the model. Also reports the run time of each scenario next to the golden one of the same build.
+# Some scenarios check a property of their totals instead of a golden output
+
+import json, os, shutil, subprocess, sys, tempfile, time
+
+sys.dont_write_bytecode = True
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Log_Comparator"))
+from compare_states import FIELDS, read_states
+
+HERE      = os.path.dirname(os.path.abspath(__file__))
+REPO      = os.path.abspath(os.path.join(HERE, "..", ".."))
+GOLDEN    = os.path.join(HERE, "golden")
+DEFAULT_MODEL = os.path.join(REPO, "bin", "pandemic-geographical_model")
+DEFAULT_BUILD = "Release" # The build of ./run_simulation.sh
+
+# |total - golden| <= absolute + relative * |golden| for every day. The absolute part is in people
+DEFAULT_TOLERANCE = {"relative": 1e-4, "absolute": 1.0}
+POPULATION_TOLERANCE = {"relative": 1e-9, "absolute": 1e-3}
+
+CASES = {
+    # A 12 x 12 grid with vaccinations and movement restrictions, written by synthetic_scenario()
+    "synthetic": {"days": 120, "tolerances": {}},
+
+    # Only the age group 0 of the corner is exposed, and the contact_matrix keeps age group 0 from infecting
+    # anyone, so nobody else may ever be exposed. With both infection pressures
+    "contact_matrix": {"days": 60, "writer": lambda path: synthetic_scenario(path, CONTACT_CONFIG, seeded_ages=[0]),
+                       "check": lambda totals: never_exposed(totals)},
+    "contact_matrix_spmv": {"days": 60, "writer": lambda path: synthetic_scenario(path, dict(CONTACT_CONFIG, infection_pressure="spmv"), seeded_ages=[0]),
+                            "check": lambda totals: never_exposed(totals)},
+
+    # The hospitals of the corner fill up, which amplifies the fatality rates: the age-inner kernel must give the totals
+    # of the default age-outer one, both amplifying them from the infections at the start of each day
+    "age_inner": {"days": 120, "writer": lambda path: synthetic_scenario(path, {"cell_kernel": "age_inner"}, HOSPITAL_STATE),
+                  "reference": lambda path: synthetic_scenario(path, {}, HOSPITAL_STATE),
+                  "tolerances": {field: {"relative": 1e-9, "absolute": 1e-6} for field in FIELDS}},
+
+    # The regions settle, send their state to wake up on the day a stage of their timeline lets people travel, and are
+    # then infected and settle again when the stochastic transitions end their epidemic. With an inertial delay the states
+    # they sent meanwhile replaced the one that was to wake them, so they must send it again: the totals must be those
+    # of the transport delay
+    "timeline_inertial": {"days": 200, "writer": lambda path: timeline_scenario(path, "inertial"),
+                          "reference": lambda path: timeline_scenario(path, "transport"),
+                          "tolerances": {field: {"relative": 1e-9, "absolute": 1e-6} for field in FIELDS}},
+
+    # The world countries of cadmium_gis, run from an input directory written by area_tree(), whose state log must be
+    # byte for byte that of the scenario generateScenario.py writes from the same directory
+    "area": {"days": 60, "area": "world"},
+
+    # The world countries of cadmium_gis, run from the scenario generateScenario.py writes from an input directory
+    # written by area_tree()
+    "world": {"generated": "world", "days": 200, "tolerances": {}},
+}
+
+CONTACT_CONFIG = {"contact_matrix": [[0.0, 1.0], [0.0, 1.0]], "travel_restriction": "total"}
+HOSPITAL_STATE = {"hospital_capacity": 0.01, "fatality_modifier": 3.0}
+TIMELINE_CONFIG = {"Vaccinations": False, "Re-Susceptibility": False, "stochastic": True, "travel_restriction": "total",
+                   "timeline": "../timeline.json"}
+TIMELINE = {"events": [{"day": 180, "config": {"travel_restriction": "none"}}]}
+
+def usage():
+    print("\033[33mregression -- Usage")
+    print(" \033[36m$ python3 regression.py [--model=<executable>] [--build=<name>] [--case=<name>] [--bless] [--threads=<n>]\033[0m")
+    print(" --model   the model to test (default: bin/pandemic-geographical_model)")
+    print(" --build   how the model was built (default: " + DEFAULT_BUILD + "), whose golden run times it is timed against")
+    print(" --case    only runs that scenario (" + ", ".join(CASES) + ")")
+    print(" --bless   replaces the golden outputs by those of this model instead of comparing them")
+    print(" --threads also runs the scenario as an ensemble of n seeds on 1 and on n threads, whose logs must be identical")
+    sys.exit(-1)
+
+AGE_GROUPS, Te, Ti, Tr, Td = 2, 5, 10, 20, 20
+
+def default_cell(config={}):
+    """ The default cell of the scenarios written here, with the config patched over its own """
+    zeros = lambda n: [[0.0] * n for _ in range(AGE_GROUPS)]
+    rates = lambda n, value: [[value] * n for _ in range(AGE_GROUPS)]
+    incubation = [[0.2] * (Te - 1) + [1.0] for _ in range(AGE_GROUPS)]
+    recovery   = [[0.05] * (Ti - 1) + [0.98] for _ in range(AGE_GROUPS)]
+    fatality   = [[0.001] * (Ti - 1) + [0.02] for _ in range(AGE_GROUPS)]
+    correction = {"0.0": [1.0, 0.0], "0.05": [0.6, 0.02], "0.2": [0.3, 0.05]}
+
+    default = {
+        "delay": "transport", "cell_type": "zhong",
+        "state": {"population": 1000, "age_group_proportions": [0.4, 0.6], "susceptible": [[1.0], [1.0]],
+                  "vaccinatedD1": zeros(Td), "vaccinatedD2": zeros(Td), "exposed": zeros(Te), "exposedD1": zeros(Te),
+                  "exposedD2": zeros(Te), "infected": zeros(Ti), "infectedD1": zeros(Ti), "infectedD2": zeros(Ti),
+                  "recovered": zeros(Tr), "recoveredD1": zeros(Tr), "recoveredD2": zeros(Tr), "fatalities": [0.0, 0.0],
+                  "disobedient": 0.1, "hospital_capacity": 0.1, "fatality_modifier": 1.5,
+                  "immunityD1": rates(5, 0.6), "immunityD2": rates(5, 0.9), "min_interval_between_doses": 10,
+                  "min_interval_between_recovery_and_vaccine": 5},
+        "config": {"precision": 1000000000, "virulence_rates": rates(Ti, 0.6), "incubation_rates": incubation,
+                   "recovery_rates": recovery, "mobility_rates": rates(Ti, 0.4), "fatality_rates": fatality,
+                   "Re-Susceptibility": True, "Vaccinations": True, "travel_restriction": "partial",
+                   "vaccination_rates_dose1": rates(1, 0.01), "vaccination_rates_dose2": rates(30, 0.02),
+                   "incubation_rates_dose1": incubation, "incubation_rates_dose2": incubation,
+                   "recovery_rates_dose1": recovery, "recovery_rates_dose2": recovery,
+                   "fatality_rates_dose1": fatality, "fatality_rates_dose2": fatality},
+        "neighborhood": {"default_cell_id": {"correlation": 1.0, "infection_correction_factors": correction}}
+    }
+
+    default["config"].update(config)
+    return default
+
+def exposed_state(seeded_ages=(0, 1)):
+    """ The state of a region whose seeded_ages have an eighth of their people exposed """
+    seeded = [age in seeded_ages for age in range(AGE_GROUPS)]
+    return {"susceptible": [[0.875 if seed else 1.0] for seed in seeded],
+            "exposed": [[0.125 if seed else 0.0] + [0.0] * (Te - 1) for seed in seeded]}
+
+def synthetic_scenario(path, config={}, state={}, seeded_ages=(0, 1), side=12):
+    """ Writes a grid of side x side regions, with the seeded_ages of a corner exposed. The config and the state are
+        patched over the default ones """
+    correction = {"0.0": [1.0, 0.0], "0.05": [0.6, 0.02], "0.2": [0.3, 0.05]}
+    cells = {"default": default_cell(config)}
+    cells["default"]["state"].update(state)
+    for y in range(side):
+        for x in range(side):
+            cid = str(y * side + x + 1)
+            neighborhood = {cid: {"correlation": 1.0, "infection_correction_factors": correction}}
+            for dx, dy in ((1, 0), (-1, 0), (0, 1), (0, -1)):
+                if 0 <= x + dx < side and 0 <= y + dy < side:
+                    neighborhood[str((y + dy) * side + x + dx + 1)] = {"correlation": 0.5, "infection_correction_factors": correction}
+
+            cell = {"state": {"population": 1000 + 37 * int(cid)}, "neighborhood": neighborhood}
+            if cid == "1":
+                cell["state"].update(exposed_state(seeded_ages))
+            cells[cid] = cell
+
+    with open(path, "w") as scenario_file:
+        json.dump({"cells": cells}, scenario_file)
+
+def timeline_scenario(path, delay):
+    """ Writes the grid with the config of TIMELINE_CONFIG and the given delay, and its timeline next to it (the model
+        runs from the bin directory beside it) """
+    synthetic_scenario(path, TIMELINE_CONFIG)
+    with open(path) as scenario_file:
+        scenario = json.load(scenario_file)
+    scenario["cells"]["default"]["delay"] = delay
+    with open(path, "w") as scenario_file:
+        json.dump(scenario, scenario_file)
+    with open(os.path.join(os.path.dirname(path), "timeline.json"), "w") as timeline_file:
+        json.dump(TIMELINE, timeline_file)
+
+def area_tree(work_dir, area):
+    """ Copies an area of cadmium_gis into work_dir, with an input directory for it in work_dir/Scripts/Input_Generator
+        (where generateScenario.py runs) whose first region of the adjacency file is exposed. Returns its name """
+    shutil.copytree(os.path.join(REPO, "cadmium_gis", area), os.path.join(work_dir, "cadmium_gis", area))
+    generator_dir = os.path.join(work_dir, "Scripts", "Input_Generator")
+    input_name    = "input_" + area
+    os.makedirs(os.path.join(generator_dir, input_name))
+    os.makedirs(os.path.join(generator_dir, "output"))
+
+    with open(os.path.join(REPO, "cadmium_gis", area, "generatorData.json")) as generator_file:
+        area_id = json.load(generator_file)["area_id"]
+    with open(os.path.join(REPO, "cadmium_gis", area, area + "_" + area_id.lower() + "_adjacency.csv")) as adjacency_file:
+        seeded = adjacency_file.read().splitlines()[1].split(",")[0]
+
+    default = default_cell()
+    default["area"] = area
+    files = {"default.json": {"default": default}, "fields.json": {"fields": {}},
+             "infectedCell.json": {seeded: {"state": exposed_state()}}}
+    for file_name, contents in files.items():
+        with open(os.path.join(generator_dir, input_name, file_name), "w") as input_file:
+            json.dump(contents, input_file)
+    return input_name
+
+def generate_scenario(work_dir, input_name):
+    """ Runs generateScenario.py on an input directory written by area_tree(). Returns the scenario it writes """
+    generator_dir = os.path.join(work_dir, "Scripts", "Input_Generator")
+    result = subprocess.run([sys.executable, os.path.join(REPO, "Scripts", "Input_Generator", "generateScenario.py"), input_name, "-np"],
+                            cwd=generator_dir, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        print(result.stdout)
+        raise RuntimeError("generateScenario.py failed on " + input_name)
+    return os.path.join(generator_dir, "output", "scenario_" + input_name + ".json")
+
+def check_area(model, work_dir, case):
+    """ Runs generateScenario.py and the model on the scenario it writes and on its input directory. Returns the run time
+        on the input directory and the failures, or no run time and the reason when the script can't run. With geopandas, the script computes
+        the correlations itself, which also checks those of the correlations file of the area """
+    try:
+        import pandas
+    except ImportError:
+        return None, ["generateScenario.py needs pandas"]
+
+    input_name    = area_tree(work_dir, case["area"])
+    generator_dir = os.path.join(work_dir, "Scripts", "Input_Generator")
+    area_dir      = os.path.join(work_dir, "cadmium_gis", case["area"])
+    correlations  = [f for f in os.listdir(area_dir) if f.endswith("_correlations.csv")]
+    try:
+        import geopandas
+        for file_name in correlations:
+            os.rename(os.path.join(area_dir, file_name), os.path.join(work_dir, file_name))
+    except ImportError:
+        correlations = []
+
+    generated = generate_scenario(work_dir, input_name)
+    for file_name in correlations:
+        os.rename(os.path.join(work_dir, file_name), os.path.join(area_dir, file_name))
+
+    logs = []
+    for scenario in (generated, os.path.join(generator_dir, input_name)):
+        seconds = run_model(model, work_dir, scenario, case["days"])
+        with open(os.path.join(work_dir, "logs", "pandemic_state.txt")) as log_file:
+            logs.append(log_file.read().splitlines())
+
+    for line, (generated, read) in enumerate(zip(*logs)):
+        if generated != read:
+            return seconds, ["line %d of the state log: %s instead of %s" % (line + 1, read, generated)]
+    if len(logs[0]) != len(logs[1]) or len(logs[0]) == 0:
+        return seconds, ["the state log has %d lines instead of %d" % (len(logs[1]), len(logs[0]))]
+    return seconds, []
+
+def never_exposed(totals):
+    """ Fails every day after the first one with new exposures """
+    return ["new_exposed on day %d: %.6f instead of 0" % (day, value)
+            for day, value in enumerate(totals["new_exposed"]) if day > 0 and value != 0]
+
+def daily_totals(log_filename, days):
+    """ Returns {field: [total of every region on each day]}, in people except the population.
+        A region that didn't compute on a day keeps its last state """
+    states = read_states(log_filename)
+    by_time = {}
+    for (curr_time, cid), fields in states.items():
+        by_time.setdefault(float(curr_time), {})[cid] = fields
+
+    totals  = {field: [] for field in FIELDS}
+    current = {}
+    times   = sorted(by_time)
+    t = 0
+    for day in range(days + 1):
+        while t < len(times) and times[t] <= day:
+            current.update(by_time[times[t]])
+            t += 1
+
+        for i, field in enumerate(FIELDS):
+            if i == 0:
+                totals[field].append(sum(fields[0] for fields in current.values()))
+            else:
+                totals[field].append(sum(fields[0] * fields[i] for fields in current.values()))
+
+    return totals
+
+def run_model(model, work_dir, scenario, days, flags=()):
+    """ Runs the model from work_dir/bin (it writes its logs in ../logs) and returns the run time """
+    run_dir = os.path.join(work_dir, "bin")
+    os.makedirs(run_dir, exist_ok=True)
+    os.makedirs(os.path.join(work_dir, "logs"), exist_ok=True)
+
+    start = time.perf_counter()
+    result = subprocess.run([model, scenario, str(days), "-np"] + list(flags), cwd=run_dir,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    seconds = time.perf_counter() - start
+
+    if result.returncode != 0:
+        print(result.stdout)
+        raise RuntimeError("The model failed on " + scenario)
+    return seconds
+
+def compare(totals, golden, tolerances):
+    """ Returns the failures, and the largest deviation of every field relative to its tolerance """
+    failures = []
+    worst    = {}
+    for i, field in enumerate(FIELDS):
+        tolerance = tolerances.get(field, POPULATION_TOLERANCE if i == 0 else DEFAULT_TOLERANCE)
+        expected  = golden["totals"][field]
+        if len(expected) != len(totals[field]):
+            failures.append(field + " has " + str(len(totals[field])) + " days instead of " + str(len(expected)))
+            continue
+
+        for day, (value, reference) in enumerate(zip(totals[field], expected)):
+            allowed = tolerance["absolute"] + tolerance["relative"] * abs(reference)
+            ratio   = abs(value - reference) / allowed
+            if ratio > worst.get(field, (0, 0))[0]:
+                worst[field] = (ratio, day)
+            if ratio > 1:
+                failures.append("%s on day %d: %.6f instead of %.6f" % (field, day, value, reference))
+
+    return failures, worst
+
+def check_threads(model, work_dir, scenario, days, threads):
+    """ Runs the seeds 1...n as an ensemble on 1 and on n threads. Returns the members whose logs differ """
+    logs = []
+    for pool in (1, threads):
+        ensemble = os.path.join(work_dir, "ensemble_" + str(pool) + ".json")
+        with open(ensemble, "w") as ensemble_file:
+            json.dump({"threads": pool, "seeds": list(range(1, threads + 1))}, ensemble_file)
+
+        shutil.rmtree(os.path.join(work_dir, "logs"), ignore_errors=True)
+        run_model(model, work_dir, scenario, days, ["-ensemble=" + ensemble])
+
+        member_logs = {}
+        for seed in range(1, threads + 1):
+            with open(os.path.join(work_dir, "logs", "seed" + str(seed) + "_pandemic_state.txt"), "rb") as log_file:
+                member_logs[seed] = log_file.read()
+        logs.append(member_logs)
+
+    return [seed for seed in logs[0] if logs[0][seed] != logs[1][seed]]
+
+def run_case(name, case, model, build, bless, threads):
+    golden_path = os.path.join(GOLDEN, name + ".json")
+    work_dir    = tempfile.mkdtemp(prefix="sevirds_" + name + "_")
+
+    try:
+        if "area" in case:
+            seconds, failures = check_area(model, work_dir, case)
+            if seconds is None:
+                print("\033[33m" + name + ": skipped, " + failures[0] + "\033[0m")
+                return True
+
+            passed = not failures
+            print(("\033[32m" if passed else "\033[31m") + name + (": passed " if passed else ": FAILED ") + "\033[0m" + "%.2f s" % seconds)
+            for failure in failures:
+                print("  \033[31m" + failure + "\033[0m")
+            return passed
+
+        if "generated" in case:
+            try:
+                import pandas
+            except ImportError:
+                print("\033[33m" + name + ": skipped, generateScenario.py needs pandas\033[0m")
+                return True
+            scenario = generate_scenario(work_dir, area_tree(work_dir, case["generated"]))
+        else:
+            scenario = os.path.join(work_dir, "scenario.json")
+            case.get("writer", synthetic_scenario)(scenario)
+
+        seconds = run_model(model, work_dir, scenario, case["days"])
+        totals  = daily_totals(os.path.join(work_dir, "logs", "pandemic_state.txt"), case["days"])
+
+        if "check" in case:
+            failures, worst = case["check"](totals), {}
+            timing          = "%.2f s" % seconds
+        elif "reference" in case:
+            # Compared to the totals of another scenario run by the same model instead of a golden output
+            reference = os.path.join(work_dir, "reference.json")
+            case["reference"](reference)
+            run_model(model, work_dir, reference, case["days"])
+            expected        = daily_totals(os.path.join(work_dir, "logs", "pandemic_state.txt"), case["days"])
+            failures, worst = compare(totals, {"totals": expected}, case["tolerances"])
+            timing          = "%.2f s" % seconds
+        elif bless:
+            # The run times of the other builds are kept
+            times = {}
+            if os.path.isfile(golden_path):
+                with open(golden_path) as golden_file:
+                    times = json.load(golden_file)["seconds"]
+            times[build] = round(seconds, 3)
+
+            os.makedirs(GOLDEN, exist_ok=True)
+            with open(golden_path, "w") as golden_file:
+                json.dump({"days": case["days"], "seconds": times, "totals": totals}, golden_file)
+            print("\033[32m" + name + ": blessed (%.2f s, %s build)\033[0m" % (seconds, build))
+            return True
+        else:
+            if not os.path.isfile(golden_path):
+                print("\033[33m" + name + ": no golden output, run with --bless first\033[0m")
+                return False
+
+            with open(golden_path) as golden_file:
+                golden = json.load(golden_file)
+            failures, worst = compare(totals, golden, case["tolerances"])
+            # Only the run times of the same build compare
+            if build in golden["seconds"]:
+                reference = golden["seconds"][build]
+                timing    = "%.2f s (golden %.2f s, x%.2f)" % (seconds, reference, seconds / max(reference, 1e-9))
+            else:
+                timing = "%.2f s (no golden time of a %s build)" % (seconds, build)
+
+        passed = not failures
+        print(("\033[32m" if passed else "\033[31m") + name + (": passed " if passed else ": FAILED ") + "\033[0m" + timing)
+
+        for field in FIELDS:
+            if field in worst:
+                print("  " + field.ljust(16) + "%.3g of its tolerance (day %d)" % worst[field])
+        for failure in failures[:10]:
+            print("  \033[31m" + failure + "\033[0m")
+        if len(failures) > 10:
+            print("  \033[31m... and " + str(len(failures) - 10) + " more\033[0m")
+
+        if threads > 1:
+            differing = check_threads(model, work_dir, scenario, case["days"], threads)
+            if differing:
+                print("  \033[31mThe logs of the seeds " + ", ".join(map(str, differing)) + " change with the number of threads\033[0m")
+                passed = False
+            else:
+                print("  identical logs on 1 and " + str(threads) + " threads")
+
+        return passed
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+if __name__ == "__main__":
+    model   = DEFAULT_MODEL
+    build   = DEFAULT_BUILD
+    bless   = False
+    threads = 1
+    names   = list(CASES)
+
+    for flag in sys.argv[1:]:
+        if flag.startswith("--model="):
+            model = os.path.abspath(flag.split("=", 1)[1])
+        elif flag.startswith("--build="):
+            build = flag.split("=", 1)[1]
+        elif flag.startswith("--case="):
+            names = [flag.split("=", 1)[1]]
+        elif flag.startswith("--threads="):
+            threads = int(flag.split("=", 1)[1])
+        elif flag == "--bless":
+            bless = True
+        else:
+            usage()
+
+    if not os.path.isfile(model) or any(name not in CASES for name in names):
+        usage()
+
+    results = [run_case(name, CASES[name], model, build, bless, threads) for name in names]
+    sys.exit(0 if all(results) else 1)
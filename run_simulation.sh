@@ -142,6 +142,8 @@
             echo -e " ${YELLOW}--clean|-c|--clean=*|-c=*${RESET} \t Cleans all simulation runs for the selected area if no # is set, \n \t\t\t\t otherwise cleans the specified run using the folder name inputed such as 'clean=run1'"
             echo -e " ${YELLOW}--days=#|-d=#${RESET} \t\t\t Sets the number of days to run a simulation (default=500)"
             echo -e " ${YELLOW}--flags, -f${RESET}\t\t\t Displays all flags"
+            echo -e " ${YELLOW}--float32|-f32${RESET}\t\t\t Builds the model storing the compartments in single precision (compare against a normal build with Scripts/Log_Comparator)"
+            echo -e " ${YELLOW}--deterministic|-det${RESET}\t\t Builds the model with sums much less sensitive to the order of their terms (see Scripts/Regression)"
             echo -e " ${YELLOW}--gen-scenario, -gn${RESET}\t\t Generates a scenario json file (an area flag needs to be set)"
             echo -e " ${YELLOW}--gen-region-graphs=*, -grg=*${RESET}\t Generates graphs per region for previously completed simulation. Folder name set after '=' and area flag needed"
             echo -e " ${YELLOW}--graph-region, -gr${RESET}\t\t Generates graphs per region (default=off)"
@@ -309,6 +311,8 @@ if [[ $1 == "" ]]; then Help;
 else
     CLEAN="N" # Default to not clean the sim runs
     WALL="N"
+    FLOAT32="N"
+    DETERMINISTIC="N"
     PROFILE="N"
     NAME=""
     DAYS="500"
@@ -349,6 +353,14 @@ else
                 BUILD_TYPE="Debug"
                 shift
             ;;
+            --float32|-f32)
+                FLOAT32="Y"
+                shift
+            ;;
+            --deterministic|-det)
+                DETERMINISTIC="Y"
+                shift
+            ;;
             --flags|-f)
                 Help 1;
                 exit 1;
@@ -411,8 +423,8 @@ else
     if [[ ! -f "bin/pandemic-geographical_model" ]]; then
         DependencyCheck "Y" "N"
 
-        echo -e "Building Model ${YELLOW}[Type: ${BLUE}${BUILD_TYPE}${YELLOW} | Wall: ${BLUE}${WALL}${YELLOW}]${RESET}"
-        cmake CMakeLists.txt -DWALL=${WALL} -DCMAKE_BUILD_TYPE=${BUILD_TYPE} -B"${HOME_DIR}/bin" > log 2>&1
+        echo -e "Building Model ${YELLOW}[Type: ${BLUE}${BUILD_TYPE}${YELLOW} | Wall: ${BLUE}${WALL}${YELLOW} | Float32: ${BLUE}${FLOAT32}${YELLOW} | Deterministic: ${BLUE}${DETERMINISTIC}${YELLOW}]${RESET}"
+        cmake CMakeLists.txt -DWALL=${WALL} -DFLOAT32=${FLOAT32} -DDETERMINISTIC=${DETERMINISTIC} -DCMAKE_BUILD_TYPE=${BUILD_TYPE} -B"${HOME_DIR}/bin" > log 2>&1
         ErrorCheck $? log
         cmake --build bin > log 2>&1
         ErrorCheck $? log # Check for build errors
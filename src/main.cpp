@@ -33,8 +33,11 @@
 #include <cadmium/engine/pdevs_dynamic_runner.hpp>
 #include <cadmium/logger/common_loggers.hpp>
 #include "model/geographical_coupled.hpp"
+#include "model/ensemble.hpp"
+#include "model/calibration.hpp"
 #include <thread>
 #include <chrono>
+#include <mutex>
 
 using namespace std;
 using namespace cadmium;
@@ -43,10 +46,16 @@ using namespace cadmium::celldevs;
 using TIME = float;
 
 /*************** Loggers *******************/
-static ofstream out_messages("../logs/pandemic_messages.txt");
-struct oss_sink_messages { static ostream& sink(){ return out_messages; } };
-static ofstream out_state("../logs/pandemic_state.txt");
-struct oss_sink_state { static ostream& sink() { return out_state; } };
+// Only opened by a single run (see main()), so that an ensemble or a calibration leaves the logs of the last run alone
+static ofstream out_messages;
+static ofstream out_state;
+
+// The members of an ensemble run on their own threads and each logs to its own files
+thread_local ostream* messages_sink = &out_messages;
+thread_local ostream* state_sink    = &out_state;
+
+struct oss_sink_messages { static ostream& sink(){ return *messages_sink; } };
+struct oss_sink_state { static ostream& sink() { return *state_sink; } };
 
 using state             = logger::logger<logger::logger_state,          dynamic::logger::formatter<TIME>,   oss_sink_state>;
 using log_messages      = logger::logger<logger::logger_messages,       dynamic::logger::formatter<TIME>,   oss_sink_messages>;
@@ -54,12 +63,158 @@ using global_time_mes   = logger::logger<logger::logger_global_time,    dynamic:
 using global_time_sta   = logger::logger<logger::logger_global_time,    dynamic::logger::formatter<TIME>,   oss_sink_state>;
 using logger_top        = logger::multilogger<state,                    log_messages,                       global_time_mes, global_time_sta>;
 
+/**
+ * @brief Runs a model until the simulation time or, when its config has an early_stop, one day at a time until its
+ * epidemic is over (see epidemic_monitor.hpp). The cells are then aged to the last day if the early_stop asks for it
+ *
+ * @param r Runner of the model
+ * @param model Model, which shares its cells with the one the runner was given
+ * @param sim_time Simulation time
+ * @param state_log Where the state logger writes
+ * @return int The day the run stopped after, or -1 if it ran to the simulation time
+ */
+template <typename RUNNER>
+int run_model(RUNNER& r, geographical_coupled<TIME> const& model, TIME sim_time, ostream& state_log)
+{
+    shared_ptr<epidemic_monitor> const& monitor = model.monitor();
+    if (!monitor)
+    {
+        r.run_until(sim_time);
+        return -1;
+    }
+
+    unsigned int const last_day = (unsigned int)ceil(sim_time) - 1;
+    for (unsigned int day = 0; day < last_day; ++day)
+    {
+        r.run_until(day + 1);
+        if (monitor->end_day())
+        {
+            model.fast_forward(day, last_day, monitor->steady(), state_log);
+            return (int)day;
+        }
+    }
+
+    r.run_until(sim_time);
+    return -1;
+}
+
+/**
+ * @brief Prints why a run stopped early, if it did
+ *
+ * @param out Where to print it
+ * @param model Model that ran
+ * @param stop The day the run stopped after, or -1
+ */
+void print_early_stop(ostream& out, geographical_coupled<TIME> const& model, int stop)
+{
+    if (stop < 0)
+        return;
+
+    epidemic_monitor const& monitor = *model.monitor();
+    out << " stopped after day " << stop << ", " << (monitor.steady() ? "steady" : "over") << " with "
+        << monitor.exposed_or_infected() << " exposed or infected";
+}
+
+/**
+ * @brief Runs every member of an ensemble on the scenario that was parsed once.
+ * Each member writes its state log (and optionally its message log) in
+ * logs/<member id>_pandemic_state.txt
+ *
+ * @param scenario Scenario shared (read-only) by all the members
+ * @param ensemble Members to run
+ * @param sim_time Simulation time of every member
+ */
+void run_ensemble(scenario const& scenario, ensemble const& ensemble, TIME sim_time)
+{
+    mutex cout_mutex;
+    unsigned int done = 0;
+
+    ensemble.run([&](ensemble_member const& member)
+    {
+        ofstream member_state("../logs/" + member.id + "_pandemic_state.txt");
+        ofstream member_messages;
+        ostream null_sink(nullptr);
+
+        if (ensemble.log_messages)
+            member_messages.open("../logs/" + member.id + "_pandemic_messages.txt");
+
+        state_sink    = &member_state;
+        messages_sink = ensemble.log_messages ? (ostream*)&member_messages : &null_sink;
+        Random::seed(member.seed);
+
+        geographical_coupled<TIME> model = geographical_coupled<TIME>("");
+        model.add_cells(scenario, member.config, member.state);
+        model.couple_cells();
+
+        shared_ptr<cadmium::dynamic::modeling::coupled <TIME>>
+        t = make_shared<geographical_coupled<TIME>>(model);
+
+        cadmium::dynamic::engine::runner<TIME, logger_top> r(t, {0});
+        int const stop = run_model(r, model, sim_time, member_state);
+        model.write_sensitivity("../logs/" + member.id + "_pandemic_sensitivity.csv");
+
+        state_sink    = &out_state;
+        messages_sink = &out_messages;
+
+        lock_guard<mutex> lock{cout_mutex};
+        cout << "\r\033[33m" << ++done << "/" << ensemble.members.size() << "\033[0m " << member.id;
+        print_early_stop(cout, model, stop);
+        cout << endl;
+    });
+}
+
+/**
+ * @brief Fits the parameters of a calibration to its observed series. Every candidate is run in this process on the
+ * scenario that was parsed once, one day at a time and without any log, and stops as soon as it can't be the best.
+ * Every run is written in logs/calibration.csv
+ *
+ * @param scenario Scenario shared (read-only) by all the runs
+ * @param calibration Parameters and observations to fit
+ * @param sim_time Only the observations before that time are used
+ */
+void run_calibration(scenario const& scenario, calibration& calibration, TIME sim_time)
+{
+    calibration.check_regions(scenario);
+    unsigned int const days = min<unsigned int>(calibration.num_days(), (unsigned int)ceil(sim_time));
+
+    calibration_evaluation best = calibration.search([&](vector<double> const& values, atomic<double> const& bound)
+    {
+        Random::seed(calibration.seed);
+        auto series = make_shared<region_series>(calibration.regions, calibration.series);
+
+        geographical_coupled<TIME> model = geographical_coupled<TIME>("");
+        model.observe_regions(series);
+        model.add_cells(scenario, calibration.config_overrides(values, scenario.configs), calibration.state_overrides(values));
+        model.couple_cells();
+
+        shared_ptr<cadmium::dynamic::modeling::coupled <TIME>>
+        t = make_shared<geographical_coupled<TIME>>(model);
+
+        cadmium::dynamic::engine::runner<TIME, cadmium::logger::not_logger> r(t, {0});
+
+        calibration_evaluation evaluation{values, 0, 0};
+        while (evaluation.days < days && evaluation.error <= bound)
+        {
+            r.run_until(evaluation.days + 1);
+            evaluation.error += calibration.day_error(evaluation.days++, *series);
+        }
+        return evaluation;
+    });
+
+    calibration.write_history("../logs/calibration.csv");
+
+    cout << "\r\033[33m" << calibration.history.size() << " runs, error " << best.error << "\033[0m";
+    for (unsigned int p = 0; p < calibration.parameters.size(); ++p)
+        cout << " " << calibration.parameters.at(p).key << "=" << best.values.at(p);
+    cout << endl;
+}
+
 int main(int argc, char** argv)
 {
     if (argc < 2)
     {
         cerr << "\033[31mProgram used with wrong parameters. The program must be invoked as follows: "
-            << argv[0] << " SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)]\33[0m" << endl;
+            << argv[0] << " SCENARIO_CONFIG.json|INPUT_DIRECTORY [MAX_SIMULATION_TIME (default: 500)] [-np] [-ensemble=ENSEMBLE.json] [-calibrate=CALIBRATION.json] [-area=AREA_DIRECTORY]\33[0m" << endl;
         throw;
     }
 
@@ -75,28 +230,78 @@ int main(int argc, char** argv)
     if (!file_existence_checker.is_open())
         throw runtime_error{"Unable to open the file: " + string{argv[1]}};
 
+    float sim_time = (argc > 2) ? atof(argv[2]) : 500;
+
+    // Optional flags after MAX_SIMULATION_TIME
+    bool noProgress = false;
+    string ensemble_file_path;
+    string calibration_file_path;
+    string area_dir;
+    for (int i = 3; i < argc; ++i)
+    {
+        string flag = argv[i];
+        if (flag == "-np")
+            noProgress = true;
+        else if (flag.rfind("-ensemble=", 0) == 0)
+            ensemble_file_path = flag.substr(flag.find('=') + 1);
+        else if (flag.rfind("-calibrate=", 0) == 0)
+            calibration_file_path = flag.substr(flag.find('=') + 1);
+        else if (flag.rfind("-area=", 0) == 0)
+            area_dir = flag.substr(flag.find('=') + 1);
+    }
+
     // Note: At the time of this writing, the web viewer that consumes the log files of this simulator relies on the
     // the input to geographical_coupled parameter (param name: id) to be empty; this changes how the IDs of cells
     // in the log files are printed.
-    geographical_coupled<TIME> test = geographical_coupled<TIME>("");
     string scenario_config_file_path = argv[1];
-    test.add_cells_json(scenario_config_file_path);
+    scenario parsed_scenario;
+
+    // An input directory (the one of default.json) is built with the files of its area instead of a generated scenario
+    if (ifstream{scenario_config_file_path + "/default.json"}.is_open())
+        parsed_scenario.load_area(scenario_config_file_path, area_dir);
+    else
+        parsed_scenario = scenario{scenario_config_file_path};
+
+    if (!calibration_file_path.empty())
+    {
+        calibration calibration{calibration_file_path};
+        run_calibration(parsed_scenario, calibration, sim_time);
+        cout << "\r\033[1;32mDone.       \033[0m" << endl;
+        return 0;
+    }
+
+    if (!ensemble_file_path.empty())
+    {
+        run_ensemble(parsed_scenario, ensemble{ensemble_file_path}, sim_time);
+        cout << "\r\033[1;32mDone.       \033[0m" << endl;
+        return 0;
+    }
+
+    out_messages.open("../logs/pandemic_messages.txt");
+    out_state.open("../logs/pandemic_state.txt");
+
+    geographical_coupled<TIME> test = geographical_coupled<TIME>("");
+    test.add_cells(parsed_scenario);
     test.couple_cells();
 
     shared_ptr<cadmium::dynamic::modeling::coupled <TIME>>
     t = make_shared<geographical_coupled<TIME>>(test);
 
-    // Has the 'no progress' flag been set?
-    bool noProgress = (argc > 3) && strcmp((argv[3]), "-np") == 0;
-
     cadmium::dynamic::engine::runner<TIME, logger_top> r(t, {0});
 
     // Turn on the progress meter
     if (!noProgress)
         r.turn_progress_on();
 
-    float sim_time = (argc > 2) ? atof(argv[2]) : 500;
-    r.run_until(sim_time);
+    int const stop = run_model(r, test, sim_time, out_state);
+    if (stop >= 0)
+    {
+        cout << "\r\033[33mThe epidemic";
+        print_early_stop(cout, test, stop);
+        cout << "\033[0m" << endl;
+    }
+    test.print_far_field_report(cout);
+    test.write_sensitivity("../logs/pandemic_sensitivity.csv");
 
     // The spaces at the the end are necessary to clear the terminal
     // line that's being overwritten
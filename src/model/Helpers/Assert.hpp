@@ -1,18 +1,28 @@
 #ifndef ASSERT_HPP
 #define ASSERT_HPP
 
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
 using namespace std;
 
 namespace Assert
 {
+    // Built with SEVIRDS_ASSERT_THROWS (the library, see pandemic.h) a failed assertion throws
+    // instead of ending the process, which may not be the model's own
     void AssertLong(bool condition, string file, unsigned int line, string message="")
     {
         if (!condition)
         {
             string filename = file.substr(file.find_last_of("/\\") + 1);
+#ifdef SEVIRDS_ASSERT_THROWS
+            throw runtime_error{filename + " (ln" + to_string(line) + ") " + message};
+#else
             cout << "\n\033[1;31mASSERT in " << filename << " (ln" << line 
                 << ") \033[0;31m" << message << "\033[0m" << endl;
             abort();
+#endif
         }
     }
 } // Assert
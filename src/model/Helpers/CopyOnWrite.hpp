@@ -0,0 +1,111 @@
+#ifndef COPY_ON_WRITE_HPP
+#define COPY_ON_WRITE_HPP
+
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace CopyOnWrite
+{
+    /**
+     * @brief Buffers of type T that are no longer used by any snapshot. Each thread has its own
+     * so that the simulations of an ensemble never share one. Reusing a buffer keeps the memory
+     * the vectors inside of it already allocated
+    */
+    template <typename T>
+    class free_list
+    {
+        public:
+            ~free_list()
+            {
+                destroyed() = true;
+                for (T* buffer : buffers)
+                    delete buffer;
+            }
+
+            static free_list& get()
+            {
+                thread_local free_list list;
+                return list;
+            }
+
+            // The free list of a thread is destroyed when the thread exits, snapshots released after that are just deleted
+            static bool& destroyed()
+            {
+                thread_local bool is_destroyed = false;
+                return is_destroyed;
+            }
+
+            T* acquire()
+            {
+                if (buffers.empty())
+                    return new T{};
+
+                T* buffer = buffers.back();
+                buffers.pop_back();
+                return buffer;
+            }
+
+            static void release(T* buffer)
+            {
+                if (destroyed() || get().buffers.size() >= max_buffers)
+                    delete buffer;
+                else
+                    get().buffers.push_back(buffer);
+            }
+
+        private:
+            static constexpr size_t max_buffers = 4096;
+            vector<T*> buffers;
+    };
+} // CopyOnWrite
+
+/**
+ * Value of type T that is shared by all its copies until one of them is modified through edit(),
+ * which then gets its own copy. Copying one is only a reference count increment.
+*/
+template <typename T>
+class copy_on_write
+{
+    public:
+        copy_on_write() : data{new T{}, &CopyOnWrite::free_list<T>::release} { }
+
+        explicit copy_on_write(T value) : data{acquire()} { *data = move(value); }
+
+        T const& operator*() const  { return *data;     }
+        T const* operator->() const { return data.get(); }
+
+        /**
+         * @brief Gives write access to the value, copying it first if another snapshot shares it
+         *
+         * @return T&
+        */
+        T& edit()
+        {
+            if (data.use_count() != 1)
+            {
+                shared_ptr<T> copy = acquire();
+                *copy = *data;
+                data = move(copy);
+            }
+
+            return *data;
+        }
+
+        // Whether both hold the very same value (as opposed to an equal one)
+        bool shares(copy_on_write const& other) const { return data == other.data; }
+
+        // Only compares the values when they aren't shared
+        bool operator!=(copy_on_write const& other) const { return !shares(other) && *data != *other.data; }
+
+    private:
+        shared_ptr<T> data;
+
+        static shared_ptr<T> acquire()
+        {
+            return shared_ptr<T>(CopyOnWrite::free_list<T>::get().acquire(), &CopyOnWrite::free_list<T>::release);
+        }
+};
+
+#endif // COPY_ON_WRITE_HPP
@@ -0,0 +1,112 @@
+#ifndef DUAL_HPP
+#define DUAL_HPP
+
+#include <array>
+#include <cmath>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+
+/**
+ * Dual number for forward-mode differentiation: a value and its derivatives with respect to N parameters.
+ * Every operation carries the derivatives along (d(a * b) = a * db + b * da...), so running the model with
+ * duals instead of doubles gives the derivatives of every result in the same run. The comparisons only look
+ * at the values, which makes the branches of the model (hospitals full, travel restrictions...) act as
+ * steps whose derivative is 0.
+*/
+template <unsigned int N>
+struct dual
+{
+    double value = 0;
+    array<double, N> d{}; // d[i] = d value / d parameter i
+
+    dual() = default;
+    dual(double value) : value{value} { }
+
+    explicit operator double() const { return value; }
+
+    dual& operator+=(dual const& b) { value += b.value; for (unsigned int i = 0; i < N; ++i) d[i] += b.d[i]; return *this; }
+    dual& operator-=(dual const& b) { value -= b.value; for (unsigned int i = 0; i < N; ++i) d[i] -= b.d[i]; return *this; }
+    dual& operator+=(double b)      { value += b; return *this; }
+    dual& operator-=(double b)      { value -= b; return *this; }
+    dual& operator*=(dual const& b) { return *this = *this * b; }
+    dual& operator*=(double b)      { return *this = *this * b; }
+    dual& operator/=(dual const& b) { return *this = *this / b; }
+    dual& operator/=(double b)      { return *this = *this / b; }
+
+    friend dual operator-(dual a) { a.value = -a.value; for (double& di : a.d) di = -di; return a; }
+
+    friend dual operator+(dual a, dual const& b) { return a += b; }
+    friend dual operator+(dual a, double b)      { return a += b; }
+    friend dual operator+(double a, dual b)      { return b += a; }
+    friend dual operator-(dual a, dual const& b) { return a -= b; }
+    friend dual operator-(dual a, double b)      { return a -= b; }
+    friend dual operator-(double a, dual const& b) { return -b + a; }
+
+    friend dual operator*(dual const& a, dual const& b)
+    {
+        dual res{a.value * b.value};
+        for (unsigned int i = 0; i < N; ++i)
+            res.d[i] = a.d[i] * b.value + a.value * b.d[i];
+        return res;
+    }
+
+    friend dual operator*(dual a, double b) { a.value *= b; for (double& di : a.d) di *= b; return a; }
+    friend dual operator*(double a, dual b) { return b * a; }
+
+    friend dual operator/(dual const& a, dual const& b)
+    {
+        dual res{a.value / b.value};
+        for (unsigned int i = 0; i < N; ++i)
+            res.d[i] = (a.d[i] - res.value * b.d[i]) / b.value;
+        return res;
+    }
+
+    friend dual operator/(dual a, double b) { a.value /= b; for (double& di : a.d) di /= b; return a; }
+    friend dual operator/(double a, dual const& b) { return dual{a} / b; }
+
+    friend bool operator< (dual const& a, dual const& b) { return a.value <  b.value; }
+    friend bool operator> (dual const& a, dual const& b) { return a.value >  b.value; }
+    friend bool operator<=(dual const& a, dual const& b) { return a.value <= b.value; }
+    friend bool operator>=(dual const& a, dual const& b) { return a.value >= b.value; }
+    friend bool operator==(dual const& a, dual const& b) { return a.value == b.value; }
+    friend bool operator!=(dual const& a, dual const& b) { return a.value != b.value; }
+
+    friend dual abs(dual a) { return a.value < 0 ? -a : a; }
+};
+
+template <unsigned int N>
+void from_json(nlohmann::json const& json, dual<N>& x) { x = dual<N>{json.get<double>()}; }
+
+template <unsigned int N>
+void to_json(nlohmann::json& json, dual<N> const& x) { json = x.value; }
+
+// The type the equations of the model compute with: double, or a dual number with SEVIRDS_SENSITIVITY
+// derivatives when built with -DSENSITIVITY=<number of parameters> (see simulation_config::sensitivity)
+#ifdef SEVIRDS_SENSITIVITY
+    using scalar = dual<SEVIRDS_SENSITIVITY>;
+    constexpr unsigned int num_derivatives = SEVIRDS_SENSITIVITY;
+#else
+    using scalar = double;
+    constexpr unsigned int num_derivatives = 0;
+#endif
+
+// The value of a double, a float or a dual number, without its derivatives
+inline double value_of(double x) { return x; }
+
+template <unsigned int N>
+double value_of(dual<N> const& x) { return x.value; }
+
+// The derivative with respect to parameter i. 0 for a double, which carries none
+inline double derivative_of(double, unsigned int) { return 0; }
+
+template <unsigned int N>
+double derivative_of(dual<N> const& x, unsigned int i) { return x.d.at(i); }
+
+// Sets the derivative with respect to parameter i. A double carries none, so it's left as it is
+inline void set_derivative(double&, unsigned int, double) { }
+
+template <unsigned int N>
+void set_derivative(dual<N>& x, unsigned int i, double derivative) { x.d.at(i) = derivative; }
+
+#endif // DUAL_HPP
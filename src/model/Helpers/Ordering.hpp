@@ -0,0 +1,78 @@
+#ifndef ORDERING_HPP
+#define ORDERING_HPP
+
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+using namespace std;
+
+namespace Ordering
+{
+    /**
+     * @brief Reverse Cuthill-McKee ordering of a graph. Nodes that are connected end up
+     * close to each other in the ordering, so storing them in that order keeps the
+     * neighbors of a node mostly next to it in memory
+     *
+     * @param adjacency Neighbors of every node (a node may list itself)
+     * @return vector<unsigned int> The nodes in their new order
+    */
+    inline vector<unsigned int> reverse_cuthill_mckee(vector<vector<unsigned int>> const& adjacency)
+    {
+        unsigned int const count = adjacency.size();
+
+        vector<unsigned int> degree(count);
+        for (unsigned int i = 0; i < count; ++i)
+            degree.at(i) = adjacency.at(i).size();
+
+        // Ties are broken by the original position so that the ordering is always the same
+        auto by_degree = [&degree](unsigned int a, unsigned int b) { return degree.at(a) != degree.at(b) ? degree.at(a) < degree.at(b) : a < b; };
+
+        // Each connected component is started from its node with the smallest degree
+        vector<unsigned int> starts(count);
+        for (unsigned int i = 0; i < count; ++i)
+            starts.at(i) = i;
+        sort(starts.begin(), starts.end(), by_degree);
+
+        vector<unsigned int> order;
+        order.reserve(count);
+        vector<bool> visited(count, false);
+        vector<unsigned int> next;
+
+        for (unsigned int start : starts)
+        {
+            if (visited.at(start))
+                continue;
+
+            queue<unsigned int> pending;
+            pending.push(start);
+            visited.at(start) = true;
+
+            while (!pending.empty())
+            {
+                unsigned int node = pending.front();
+                pending.pop();
+                order.push_back(node);
+
+                next.clear();
+                for (unsigned int neighbor : adjacency.at(node))
+                {
+                    if (!visited.at(neighbor))
+                    {
+                        visited.at(neighbor) = true;
+                        next.push_back(neighbor);
+                    }
+                }
+
+                sort(next.begin(), next.end(), by_degree);
+                for (unsigned int neighbor : next)
+                    pending.push(neighbor);
+            }
+        }
+
+        reverse(order.begin(), order.end());
+        return order;
+    }
+} // Ordering
+
+#endif // ORDERING_HPP
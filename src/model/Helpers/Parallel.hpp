@@ -0,0 +1,70 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Parallel
+{
+    /**
+     * @brief Calls work(i) for every i in [0, count) using a pool of threads.
+     * Each thread picks the next index as soon as it's done with its current one,
+     * so jobs of uneven length still keep every thread busy
+     *
+     * @param count Number of jobs
+     * @param threads Size of the pool (0 uses every hardware thread)
+     * @param work Job to run, receives the index of the job
+    */
+    inline void for_each_index(size_t count, unsigned int threads, function<void(size_t)> const& work)
+    {
+        if (threads == 0)
+            threads = max(1u, thread::hardware_concurrency());
+        threads = (unsigned int)min<size_t>(threads, count);
+
+        if (threads <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                work(i);
+            return;
+        }
+
+        atomic<size_t> next{0};
+        exception_ptr error = nullptr;
+        mutex error_mutex;
+
+        vector<thread> pool;
+        pool.reserve(threads);
+        for (unsigned int t = 0; t < threads; ++t)
+        {
+            pool.emplace_back([&]()
+            {
+                for (size_t i = next++; i < count; i = next++)
+                {
+                    try { work(i); }
+                    catch (...)
+                    {
+                        lock_guard<mutex> lock{error_mutex};
+                        if (!error)
+                            error = current_exception();
+                    }
+                }
+            });
+        }
+
+        for (thread& worker : pool)
+            worker.join();
+
+        // Report the first failure once all the other jobs have finished
+        if (error)
+            rethrow_exception(error);
+    }
+} // Parallel
+
+#endif // PARALLEL_HPP
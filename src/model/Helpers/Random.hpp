@@ -0,0 +1,97 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+using namespace std;
+
+namespace Random
+{
+    /**
+     * @brief Random number generator of the calling thread. Each thread has its own
+     * so that simulations running side by side (see ensemble.hpp) neither race
+     * on nor disturb each other's random sequence
+    */
+    inline mt19937& engine()
+    {
+        thread_local mt19937 generator{1};
+        return generator;
+    }
+
+    inline void seed(unsigned int seed) { engine().seed(seed); }
+
+    // Uniformly distributed value in [0, 1]
+    inline double uniform() { return (double)engine()() / (double)mt19937::max(); }
+
+    /**
+     * Counter-based random numbers: the i-th draw of a stream is a hash of its key and i (SplitMix64), so a stream costs
+     * one draw of the generator to start and a few multiplications per number, and its draws don't depend on the order
+     * the streams are used in. The key comes from the generator of the thread (see start())
+    */
+    struct counter_stream
+    {
+        uint64_t key     = 0;
+        uint64_t counter = 0;
+
+        // A new stream keyed by the generator of the thread
+        static counter_stream start()
+        {
+            mt19937& generator = engine();
+            uint64_t const high = generator();
+            return counter_stream{(high << 32) | generator(), 0};
+        }
+
+        // Uniformly distributed value in [0, 1)
+        double uniform()
+        {
+            uint64_t z = key + (++counter) * 0x9E3779B97F4A7C15ull;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+            return (double)(z >> 11) * 0x1.0p-53;
+        }
+
+        /**
+         * @brief Number of successes out of n trials of probability p. Small means (n * p < 20) are drawn exactly by
+         * inversion, one step per success, and larger ones from the normal approximation rounded and kept within [0, n]
+         *
+         * @param n Number of trials
+         * @param p Probability of each trial
+         * @return double
+        */
+        double binomial(double n, double p)
+        {
+            if (n <= 0 || p <= 0)
+                return 0;
+            if (p >= 1)
+                return n;
+            if (p > 0.5)
+                return n - binomial(n, 1 - p);
+
+            double const mean = n * p;
+            if (mean < 20)
+            {
+                double const odds = p / (1 - p);
+                double probability = exp(n * log1p(-p)); // P(0)
+                double u = uniform();
+                double k = 0;
+                while (u > probability && k < n)
+                {
+                    u -= probability;
+                    ++k;
+                    probability *= odds * (n - k + 1) / k;
+                }
+                return k;
+            }
+
+            // Box-Muller
+            double const z = sqrt(-2.0 * log(1.0 - uniform())) * cos(2.0 * M_PI * uniform());
+            return min(n, max(0.0, round(mean + z * sqrt(mean * (1 - p)))));
+        }
+    };
+} // Random
+
+#endif // RANDOM_HPP
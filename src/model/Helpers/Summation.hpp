@@ -0,0 +1,65 @@
+#ifndef SUMMATION_HPP
+#define SUMMATION_HPP
+
+#include <cmath>
+#include <type_traits>
+#include "Dual.hpp"
+
+using namespace std;
+
+namespace Summation
+{
+    /**
+     * A running sum that also keeps the rounding error of every addition (Neumaier's compensated summation)
+     * and adds it back when read. Its result is that of the exact sum rounded once in nearly every case,
+     * so it barely depends on the order of the terms, unlike a plain sum whose last digits change with it.
+     * It reads and converts like the type it sums, so `compensated<scalar> sum = 0; sum += x;` replaces a scalar
+    */
+    template <typename S>
+    class compensated
+    {
+        public:
+            compensated() : sum{0}, error{0} { }
+
+            template <typename V, typename = enable_if_t<is_convertible<V, S>::value>>
+            compensated(V const& value) : sum(value), error{0} { }
+
+            compensated& operator+=(S const& term)
+            {
+                S const next = sum + term;
+
+                // The rounding error is in the smaller of the two
+                if (abs(value_of(sum)) >= abs(value_of(term)))
+                    error += (sum - next) + term;
+                else
+                    error += (term - next) + sum;
+
+                sum = next;
+                return *this;
+            }
+
+            compensated& operator-=(S const& term) { return *this += -term; }
+
+            operator S() const { return sum + error; }
+
+        private:
+            S sum;
+            S error;
+    };
+
+    // Type of the sums of the model: plain sums, or compensated ones in the builds with -DDETERMINISTIC=Y
+    // (see the README), whose last digits move much less when the terms come in another order. Neither depends
+    // on the threads of an ensemble: each member runs on a single thread, with its terms always in the same order
+#ifdef SEVIRDS_DETERMINISTIC
+    template <typename S>
+    using sum = compensated<S>;
+#else
+    template <typename S>
+    using sum = S;
+#endif
+} // Summation
+
+template <typename S>
+double value_of(Summation::compensated<S> const& x) { return value_of(S(x)); }
+
+#endif // SUMMATION_HPP
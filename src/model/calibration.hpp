@@ -0,0 +1,459 @@
+#ifndef PANDEMIC_HOYA_2002_CALIBRATION_HPP
+#define PANDEMIC_HOYA_2002_CALIBRATION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "cells/region_series.hpp"
+#include "scenario.hpp"
+#include "Helpers/Assert.hpp"
+#include "Helpers/Parallel.hpp"
+
+using namespace std;
+
+// A parameter fitted by a calibration: a table of the config scaled by a factor, or a modifier of the states set to a value
+struct calibration_parameter
+{
+    string section; // "config" or "state"
+    string key;
+    double lower;
+    double upper;
+};
+
+// One simulation run by a calibration
+struct calibration_evaluation
+{
+    vector<double> values;     // Value of each parameter
+    double error       = numeric_limits<double>::infinity();
+    unsigned int days  = 0;    // Days simulated, fewer than all of them when the run was stopped early
+};
+
+/**
+ * Fits parameters of a scenario to observed daily series of some regions, by running the scenario again and again
+ * with new values. The file looks like this (every entry but "observed" and "parameters" is optional):
+ *  {
+ *      "observed": "observed.csv",
+ *      "series": "new_infected",
+ *      "parameters": { "config": {"virulence_rates": [0.5, 2.0]}, "state": {"disobedient": [0.0, 0.5]} },
+ *      "method": "nelder_mead",
+ *      "evaluations": 200,
+ *      "threads": 8,
+ *      "seed": 1,
+ *      "tolerance": 1e-3
+ *  }
+ * The observed file has one "cell,day,value" line per region and day, compared to the "series" of the region on that day
+ * ("infected", "new_infected" or "deaths", in people, see region_series.hpp). The error of a run is the sum of the
+ * squared differences.
+ *
+ * A "config" parameter multiplies every rate of its table (ex: 1.2 makes every virulence rate 20% higher) and a "state"
+ * parameter replaces the disobedient, hospital_capacity or fatality_modifier of every cell, within [lower, upper].
+ *
+ * The candidates come from a Nelder-Mead simplex ("nelder_mead") or are drawn uniformly ("random"), and are run several
+ * at a time. A run stops as soon as its error can't beat the candidates it's compared to: the best one so far for a
+ * random search, the worst vertex of the simplex for Nelder-Mead (whose four moves of a step run at once with several threads).
+*/
+class calibration
+{
+    public:
+        vector<calibration_parameter> parameters;
+        string series        = "new_infected";
+        string method        = "nelder_mead";
+        unsigned int evaluations = 200;
+        unsigned int threads = 0; // 0 uses every hardware thread
+        unsigned int seed    = 1;
+        double tolerance     = 1e-3; // Size of the simplex at which Nelder-Mead stops, relative to the range of each parameter
+
+        // Regions with observations, and the observations of each day: (index into regions, value)
+        vector<string> regions;
+        vector<vector<pair<unsigned int, double>>> observations;
+
+        // Every run so far, in the order they finished
+        vector<calibration_evaluation> history;
+
+        unsigned int num_days() const { return observations.size(); }
+
+        explicit calibration(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            nlohmann::json json;
+            file >> json;
+
+            if (json.contains("series"))      json.at("series").get_to(series);
+            if (json.contains("method"))      json.at("method").get_to(method);
+            if (json.contains("evaluations")) json.at("evaluations").get_to(evaluations);
+            if (json.contains("threads"))     json.at("threads").get_to(threads);
+            if (json.contains("seed"))        json.at("seed").get_to(seed);
+            if (json.contains("tolerance"))   json.at("tolerance").get_to(tolerance);
+
+            AssertLong(method == "nelder_mead" || method == "random", __FILE__, __LINE__,
+                        "The calibration method must be either \"nelder_mead\" or \"random\", not \"" + method + "\"");
+
+            for (string const section : {"config", "state"})
+            {
+                if (!json.at("parameters").contains(section))
+                    continue;
+
+                for (auto const& item : json.at("parameters").at(section).items())
+                {
+                    vector<double> const range = item.value().get<vector<double>>();
+                    AssertLong(range.size() == 2 && range.at(0) <= range.at(1), __FILE__, __LINE__,
+                                "The calibration range of " + item.key() + " must be [lower, upper]");
+                    parameters.push_back({section, item.key(), range.at(0), range.at(1)});
+                }
+            }
+            AssertLong(!parameters.empty(), __FILE__, __LINE__, "The calibration " + file_path + " has no parameters");
+
+            load_observed(json.at("observed").get<string>());
+        }
+
+        // Makes sure every observed region is a cell of the scenario
+        void check_regions(scenario const& scenario) const
+        {
+            unordered_map<string, bool> found;
+            for (string const& region : regions)
+                found.insert({region, false});
+            for (scenario_cell const& cell : scenario.cells)
+            {
+                auto region = found.find(cell.cell_id);
+                if (region != found.end())
+                    region->second = true;
+            }
+
+            for (auto const& region : found)
+                AssertLong(region.second, __FILE__, __LINE__, "The observed region " + region.first + " isn't a cell of the scenario");
+        }
+
+        /**
+         * @brief The config overrides of a candidate: the tables of its "config" parameters scaled, for each config of the scenario
+         *
+         * @param values Value of each parameter
+         * @param configs Configs of the scenario (see scenario::configs)
+         * @return vector<nlohmann::json>
+        */
+        vector<nlohmann::json> config_overrides(vector<double> const& values, vector<nlohmann::json> const& configs) const
+        {
+            vector<nlohmann::json> overrides(configs.size(), nlohmann::json::object());
+            for (unsigned int p = 0; p < parameters.size(); ++p)
+            {
+                if (parameters.at(p).section != "config")
+                    continue;
+
+                for (unsigned int c = 0; c < configs.size(); ++c)
+                {
+                    AssertLong(configs.at(c).contains(parameters.at(p).key), __FILE__, __LINE__,
+                                "The config of the scenario has no " + parameters.at(p).key + " to calibrate");
+                    overrides.at(c)[parameters.at(p).key] = scaled(configs.at(c).at(parameters.at(p).key), values.at(p));
+                }
+            }
+            return overrides;
+        }
+
+        // The state overrides of a candidate (see geographical_coupled::add_cells())
+        nlohmann::json state_overrides(vector<double> const& values) const
+        {
+            nlohmann::json overrides = nlohmann::json::object();
+            for (unsigned int p = 0; p < parameters.size(); ++p)
+            {
+                if (parameters.at(p).section == "state")
+                    overrides[parameters.at(p).key] = values.at(p);
+            }
+            return overrides;
+        }
+
+        /**
+         * @brief The error of a day: the squared differences between the observations and the series of the regions
+         *
+         * @param day Day of the observations
+         * @param series Series of the regions at the end of that day, in the order of regions
+         * @return double
+        */
+        double day_error(unsigned int day, region_series const& series) const
+        {
+            double error = 0;
+            for (auto const& observation : observations.at(day))
+            {
+                double const difference = series.value(observation.first) - observation.second;
+                error += difference * difference;
+            }
+            return error;
+        }
+
+        /**
+         * @brief Searches for the values with the smallest error
+         *
+         * @param evaluate Runs a candidate and returns its error, or stops as soon as its error is above the bound
+         * (which can go down during the run) and returns the error so far. Called from several threads at once
+         * @return calibration_evaluation The best run
+        */
+        calibration_evaluation search(function<calibration_evaluation(vector<double> const&, atomic<double> const&)> const& evaluate)
+        {
+            run = evaluate;
+            history.clear();
+            best = calibration_evaluation{};
+            best_error = numeric_limits<double>::infinity();
+
+            if (method == "random")
+                random_search();
+            else
+                nelder_mead();
+
+            return best;
+        }
+
+        /**
+         * @brief Writes every run as CSV: the value of each parameter, the error and the days simulated
+         *
+         * @param file_path Path of the file
+        */
+        void write_history(string const& file_path) const
+        {
+            ofstream out{file_path};
+            if (!out.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            out << "evaluation";
+            for (calibration_parameter const& parameter : parameters)
+                out << "," << parameter.key;
+            out << ",error,days" << endl;
+
+            out << setprecision(12);
+            for (unsigned int i = 0; i < history.size(); ++i)
+            {
+                out << i;
+                for (double value : history.at(i).values)
+                    out << "," << value;
+                out << "," << history.at(i).error << "," << history.at(i).days << endl;
+            }
+        }
+
+    private:
+        function<calibration_evaluation(vector<double> const&, atomic<double> const&)> run;
+        calibration_evaluation best;
+        atomic<double> best_error{numeric_limits<double>::infinity()};
+        mutex history_mutex;
+
+        void load_observed(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            unordered_map<string, unsigned int> index;
+            string line;
+            unsigned int line_number = 0;
+            while (getline(file, line))
+            {
+                ++line_number;
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || (line_number == 1 && line == "cell,day,value"))
+                    continue;
+
+                stringstream columns{line};
+                string cell, day, value;
+                getline(columns, cell, ',');
+                getline(columns, day, ',');
+                getline(columns, value, ',');
+
+                AssertLong(!cell.empty() && !day.empty() && !value.empty(), __FILE__, __LINE__,
+                            "Line " + to_string(line_number) + " of " + file_path + " must be cell,day,value");
+
+                auto found = index.insert({cell, regions.size()});
+                if (found.second)
+                    regions.push_back(cell);
+
+                unsigned int const d = stoul(day);
+                if (d >= observations.size())
+                    observations.resize(d + 1);
+                observations.at(d).push_back({found.first->second, stod(value)});
+            }
+
+            AssertLong(!observations.empty(), __FILE__, __LINE__, "The observed file " + file_path + " is empty");
+        }
+
+        // Every number of a table multiplied by a factor
+        static nlohmann::json scaled(nlohmann::json const& table, double factor)
+        {
+            if (table.is_number())
+                return table.get<double>() * factor;
+
+            AssertLong(table.is_array(), __FILE__, __LINE__, "Only numbers and tables of numbers can be calibrated");
+            nlohmann::json result = nlohmann::json::array();
+            for (nlohmann::json const& entry : table)
+                result.push_back(scaled(entry, factor));
+            return result;
+        }
+
+        // Values of a point of the unit cube, whose coordinates go from the lower to the upper bound of each parameter
+        vector<double> values_at(vector<double> const& point) const
+        {
+            vector<double> values(parameters.size());
+            for (unsigned int p = 0; p < parameters.size(); ++p)
+                values.at(p) = parameters.at(p).lower + min(1.0, max(0.0, point.at(p))) * (parameters.at(p).upper - parameters.at(p).lower);
+            return values;
+        }
+
+        /**
+         * @brief Runs candidates at the same time and keeps the best one
+         *
+         * @param points Candidates, as points of the unit cube
+         * @param bound Error above which a run is stopped. The best error so far when null
+         * @return vector<double> Error of each candidate, only a lower bound of it for those stopped early
+        */
+        vector<double> evaluate_all(vector<vector<double>> const& points, atomic<double> const* bound)
+        {
+            vector<double> errors(points.size());
+            Parallel::for_each_index(points.size(), threads, [&](size_t i)
+            {
+                calibration_evaluation evaluation = run(values_at(points.at(i)), bound ? *bound : best_error);
+                errors.at(i) = evaluation.error;
+
+                lock_guard<mutex> lock{history_mutex};
+                if (evaluation.error < best.error)
+                {
+                    best = evaluation;
+                    best_error = evaluation.error;
+                }
+                history.push_back(move(evaluation));
+            });
+            return errors;
+        }
+
+        void random_search()
+        {
+            mt19937 generator{seed};
+            uniform_real_distribution<double> uniform{0.0, 1.0};
+
+            vector<vector<double>> points(evaluations, vector<double>(parameters.size()));
+            for (vector<double>& point : points)
+            {
+                for (double& x : point)
+                    x = uniform(generator);
+            }
+
+            evaluate_all(points, nullptr);
+        }
+
+        void nelder_mead()
+        {
+            unsigned int const n = parameters.size();
+            atomic<double> const unbounded{numeric_limits<double>::infinity()};
+            bool const parallel = (threads == 0 ? thread::hardware_concurrency() : threads) > 1;
+
+            // The simplex starts around the middle of the ranges
+            vector<vector<double>> simplex(n + 1, vector<double>(n, 0.5));
+            for (unsigned int i = 0; i < n; ++i)
+                simplex.at(i + 1).at(i) = 0.75;
+            vector<double> errors = evaluate_all(simplex, &unbounded);
+
+            auto move_along = [](vector<double> const& from, vector<double> const& to, double step)
+            {
+                vector<double> point(from.size());
+                for (unsigned int i = 0; i < from.size(); ++i)
+                    point.at(i) = min(1.0, max(0.0, from.at(i) + step * (to.at(i) - from.at(i))));
+                return point;
+            };
+
+            while (history.size() < evaluations)
+            {
+                vector<unsigned int> order(n + 1);
+                for (unsigned int i = 0; i <= n; ++i)
+                    order.at(i) = i;
+                sort(order.begin(), order.end(), [&errors](unsigned int a, unsigned int b) { return errors.at(a) < errors.at(b); });
+
+                vector<double> const& best_vertex = simplex.at(order.front());
+                unsigned int const worst = order.back();
+
+                double size = 0;
+                for (vector<double> const& vertex : simplex)
+                {
+                    for (unsigned int i = 0; i < n; ++i)
+                        size = max(size, abs(vertex.at(i) - best_vertex.at(i)));
+                }
+                if (size < tolerance)
+                    break;
+
+                vector<double> centroid(n, 0.0);
+                for (unsigned int v = 0; v < n; ++v)
+                {
+                    for (unsigned int i = 0; i < n; ++i)
+                        centroid.at(i) += simplex.at(order.at(v)).at(i) / n;
+                }
+
+                // Reflection, expansion, outside and inside contraction. Only how they compare to the worst vertex
+                // matters, so the runs stop once their error is above it
+                vector<vector<double>> moves = {move_along(centroid, simplex.at(worst), -1.0), move_along(centroid, simplex.at(worst), -2.0),
+                                                move_along(centroid, simplex.at(worst), -0.5), move_along(centroid, simplex.at(worst), 0.5)};
+                atomic<double> const worst_error{errors.at(worst)};
+                vector<double> move_errors(moves.size(), numeric_limits<double>::infinity());
+
+                auto evaluate_moves = [&](vector<unsigned int> const& which)
+                {
+                    vector<vector<double>> points;
+                    for (unsigned int k : which)
+                        points.push_back(moves.at(k));
+
+                    vector<double> const move_error = evaluate_all(points, &worst_error);
+                    for (unsigned int k = 0; k < which.size(); ++k)
+                        move_errors.at(which.at(k)) = move_error.at(k);
+                };
+
+                // With several threads the four moves run at once, otherwise only those the reflection calls for
+                if (parallel)
+                    evaluate_moves({0, 1, 2, 3});
+                else
+                {
+                    evaluate_moves({0});
+                    if (move_errors.at(0) < errors.at(order.front()))
+                        evaluate_moves({1});
+                    else if (move_errors.at(0) >= errors.at(order.at(n - 1)))
+                        evaluate_moves({move_errors.at(0) < errors.at(worst) ? 2u : 3u});
+                }
+                double const reflected = move_errors.at(0);
+
+                int chosen = -1;
+                if (reflected < errors.at(order.front()))
+                    chosen = move_errors.at(1) < reflected ? 1 : 0;
+                else if (reflected < errors.at(order.at(n - 1)))
+                    chosen = 0;
+                else if (reflected < errors.at(worst))
+                    chosen = move_errors.at(2) <= reflected ? 2 : -1;
+                else
+                    chosen = move_errors.at(3) < errors.at(worst) ? 3 : -1;
+
+                if (chosen >= 0)
+                {
+                    simplex.at(worst) = moves.at(chosen);
+                    errors.at(worst)  = move_errors.at(chosen);
+                    continue;
+                }
+
+                // Shrink towards the best vertex
+                vector<vector<double>> shrunk;
+                for (unsigned int v = 1; v <= n; ++v)
+                    shrunk.push_back(move_along(simplex.at(order.front()), simplex.at(order.at(v)), 0.5));
+                vector<double> const shrunk_errors = evaluate_all(shrunk, &unbounded);
+                for (unsigned int v = 1; v <= n; ++v)
+                {
+                    simplex.at(order.at(v)) = shrunk.at(v - 1);
+                    errors.at(order.at(v))  = shrunk_errors.at(v - 1);
+                }
+            }
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_CALIBRATION_HPP
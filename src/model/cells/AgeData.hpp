@@ -9,9 +9,14 @@
 using namespace std;
 using vecDouble = vector<double>;
 using vecVecDouble = vector<vecDouble>;
+using vecScalar = vector<scalar>;
+using vecVecScalar = vector<vecScalar>;
+using vecProportion = vector<proportion>;
+using vecVecProportion = vector<vecProportion>;
 
 // Used as a null object for vectors that aren't needed
-static vecDouble EMPTY_VEC;
+static vecScalar EMPTY_VEC;
+static vecDouble EMPTY_DOUBLE_VEC;
 
 /**
  * Wrapper class that holds important simulation data
@@ -31,28 +36,29 @@ class AgeData
     private:
         // Proportion Vectors for timestep t+1
         // These will be at a current age segment index so only one vector of doubles
-        vecDouble& m_susceptible;
-        vecDouble& m_exposed;
-        vecDouble& m_infected;
-        vecDouble& m_recovered;
+        vecProportion& m_susceptible;
+        vecProportion& m_exposed;
+        vecProportion& m_infected;
+        vecProportion& m_recovered;
+
+        // Measures how far the equations move the proportions (see change_meter)
+        change_meter& m_changes;
 
         // Reduces the amount of math that is done twice.
         // The values will be added in these when first done
         // then accessed later by other equations
-        vecDouble m_newFatalities;
-        vecDouble m_newRecoveries;
-        vecDouble m_newVacFromRec;
-        vecDouble m_newExposed;
+        vecScalar m_newVacFromRec;
+        vecScalar m_newExposed;
 
         // Keeps track of the totals for the current
         // day in the simulation which saves time having
         // to compute the totals at the end of each loop
         // in local compute
-        double m_totalSusceptible;
-        double m_totalExposed;
-        double m_totalInfected;
-        double m_totalFatalities;
-        double m_totalRecoveries;
+        scalar m_totalSusceptible;
+        scalar m_totalExposed;
+        scalar m_totalInfected;
+        scalar m_totalFatalities;
+        scalar m_totalRecoveries;
 
         // Proportion Vectors for timestep t
         /* Since the original vectors are being changed by the equations 
@@ -62,16 +68,16 @@ class AgeData
         *   certain cases (ex: any equation that needs F(q) can just reference this
         *   list instead of calculating it again).
         */
-        vecDouble m_OriginalSusceptible;
-        vecDouble m_OriginalExposed;
-        vecDouble m_OriginalInfected;
-        vecDouble m_OriginalRecovered;
+        vecScalar m_OriginalSusceptible;
+        vecScalar m_OriginalExposed;
+        vecScalar m_OriginalInfected;
+        vecScalar m_OriginalRecovered;
 
         // Config Vectors
-        vecDouble const& m_incubRates;
-        vecDouble const& m_recovRates;
-        vecDouble const& m_fatalRates;
-        vecDouble const& m_vacRates;
+        vecScalar const& m_incubRates;
+        vecScalar const& m_recovRates;
+        vecScalar const& m_fatalRates;
+        vecScalar const& m_vacRates;
         vecDouble const& m_immuneRates;
 
         // Phase Lengths
@@ -81,16 +87,16 @@ class AgeData
         unsigned int m_recoveredPhase;
 
         PopType m_popType;
+        unsigned int m_age;
     public:
-        AgeData(unsigned int age, vecVecDouble& susc, vecVecDouble& exp, vecVecDouble& inf,
-                vecVecDouble& rec, vecVecDouble const& incub_r, vecVecDouble const& rec_r,
-                vecVecDouble const& fat_r, vecDouble const& vac_r, vecDouble const& immu_r, PopType type=PopType::NVAC) :
+        AgeData(change_meter& changes, unsigned int age, vecVecProportion& susc, vecVecProportion& exp, vecVecProportion& inf,
+                vecVecProportion& rec, vecVecScalar const& incub_r, vecVecScalar const& rec_r,
+                vecVecScalar const& fat_r, vecScalar const& vac_r, vecDouble const& immu_r, PopType type=PopType::NVAC) :
             m_susceptible(susc.at(age)),
             m_exposed(exp.at(age)),
             m_infected(inf.at(age)),
             m_recovered(rec.at(age)),
-            m_newFatalities(inf.at(age).size(), 0.0),
-            m_newRecoveries(inf.at(age).size(), 0.0),
+            m_changes(changes),
             m_newVacFromRec(rec.at(age).size(), 0.0),
             m_newExposed(susc.at(age).size(), 0.0),
             m_totalSusceptible(0.0),
@@ -98,16 +104,17 @@ class AgeData
             m_totalInfected(0.0),
             m_totalFatalities(0.0),
             m_totalRecoveries(0.0),
-            m_OriginalSusceptible(susc.at(age)),
-            m_OriginalExposed(exp.at(age)),
-            m_OriginalInfected(inf.at(age)),
-            m_OriginalRecovered(rec.at(age)),
+            m_OriginalSusceptible(susc.at(age).begin(), susc.at(age).end()),
+            m_OriginalExposed(exp.at(age).begin(), exp.at(age).end()),
+            m_OriginalInfected(inf.at(age).begin(), inf.at(age).end()),
+            m_OriginalRecovered(rec.at(age).begin(), rec.at(age).end()),
             m_incubRates(incub_r.at(age)),
             m_recovRates(rec_r.at(age)),
             m_fatalRates(fat_r.at(age)),
             m_vacRates(vac_r),     // Don't .at() this one since it may be EMPTY_VEC
-            m_immuneRates(immu_r), // This one too may be EMPTY_VEC
-            m_popType(type)
+            m_immuneRates(immu_r), // This one too may be EMPTY_DOUBLE_VEC
+            m_popType(type),
+            m_age(age)
         {
             // -1 so for loops are easier
             m_susceptiblePhase = m_susceptible.size() - 1;
@@ -118,45 +125,40 @@ class AgeData
             m_OriginalExposed.reserve(m_exposedPhase + 1);
             m_OriginalInfected.reserve(m_infectedPhase + 1);
             m_OriginalRecovered.reserve(m_recoveredPhase + 1);
-            m_newFatalities.reserve(m_infectedPhase + 1);
         }
 
         // Non-Vaccinated
         //  No vaccination or immunity rates
-        AgeData(unsigned int age, vecVecDouble& susc, vecVecDouble& exp, vecVecDouble& inf,
-            vecVecDouble& rec, vecVecDouble const& incub_r, vecVecDouble const& rec_r, vecVecDouble const& fat_r) :
-            AgeData(age, susc, exp, inf, rec, incub_r, rec_r, fat_r, EMPTY_VEC, EMPTY_VEC)
+        AgeData(change_meter& changes, unsigned int age, vecVecProportion& susc, vecVecProportion& exp, vecVecProportion& inf,
+            vecVecProportion& rec, vecVecScalar const& incub_r, vecVecScalar const& rec_r, vecVecScalar const& fat_r) :
+            AgeData(changes, age, susc, exp, inf, rec, incub_r, rec_r, fat_r, EMPTY_VEC, EMPTY_DOUBLE_VEC)
         { }
 
         // GETTERS
-        double GetSusceptibleBack()     { return m_susceptible.back();         }
-        double GetRecoveredBack()       { return m_recovered.back();           }
-        double GetNewFatalitiesBack()   { return m_newFatalities.back();       }
-        double GetNewRecoveredBack()    { return m_newRecoveries.back();       }
-        double GetOrigSusceptibleBack() { return m_OriginalSusceptible.back(); }
-        double GetOrigInfectedBack()    { return m_OriginalInfected.back();    }
-        double GetOrigRecoveredBack()   { return m_OriginalRecovered.back();   }
-
-        double GetTotalSusceptible() { return m_totalSusceptible; }
-        double GetTotalExposed()     { return m_totalExposed;     }
-        double GetTotalInfected()    { return m_totalInfected;    }
-        double GetTotalRecovered()   { return m_totalRecoveries;  }
-        double GetTotalFatalities()  { return m_totalFatalities;  }
-
-        double GetNewFatalities(int index) { return m_newFatalities.at(index); }
-        double GetNewRecovered(int index)  { return m_newRecoveries.at(index); }
-        double GetVacFromRec(int index)    { return m_newVacFromRec.at(index); }
-        double GetNewExposed(int index)    { return m_newExposed.at(index);    }
-
-        double GetOrigSusceptible(int index) { return m_OriginalSusceptible.at(index); }
-        double GetOrigExposed(int index)     { return m_OriginalExposed.at(index);     }
-        double GetOrigInfected(int index)    { return m_OriginalInfected.at(index);    }
-        double GetOrigRecovered(int index)   { return m_OriginalRecovered.at(index);   }
-
-        double GetIncubationRate(int index)  { return m_incubRates.at(index);    }
-        double GetRecoveryRate(int index)    { return m_recovRates.at(index);    }
-        double GetFatalityRate(int index)    { return m_fatalRates.at(index);    }
-        double GetVaccinationRate(int index) { return m_vacRates.at(index);      }
+        scalar GetSusceptibleBack()     { return m_susceptible.back();         }
+        scalar GetRecoveredBack()       { return m_recovered.back();           }
+        scalar GetOrigSusceptibleBack() { return m_OriginalSusceptible.back(); }
+        scalar GetOrigInfectedBack()    { return m_OriginalInfected.back();    }
+        scalar GetOrigRecoveredBack()   { return m_OriginalRecovered.back();   }
+
+        scalar GetTotalSusceptible() { return m_totalSusceptible; }
+        scalar GetTotalExposed()     { return m_totalExposed;     }
+        scalar GetTotalInfected()    { return m_totalInfected;    }
+        scalar GetTotalRecovered()   { return m_totalRecoveries;  }
+        scalar GetTotalFatalities()  { return m_totalFatalities;  }
+
+        scalar GetVacFromRec(int index)    { return m_newVacFromRec.at(index); }
+        scalar GetNewExposed(int index)    { return m_newExposed.at(index);    }
+
+        scalar GetOrigSusceptible(int index) { return m_OriginalSusceptible.at(index); }
+        scalar GetOrigExposed(int index)     { return m_OriginalExposed.at(index);     }
+        scalar GetOrigInfected(int index)    { return m_OriginalInfected.at(index);    }
+        scalar GetOrigRecovered(int index)   { return m_OriginalRecovered.at(index);   }
+
+        scalar GetIncubationRate(int index)  { return m_incubRates.at(index);    }
+        scalar GetRecoveryRate(int index)    { return m_recovRates.at(index);    }
+        scalar GetFatalityRate(int index)    { return m_fatalRates.at(index);    }
+        scalar GetVaccinationRate(int index) { return m_vacRates.at(index);      }
         double GetImmunityRate(int index)    { return m_immuneRates.at(index);   }
 
         unsigned int GetSusceptiblePhase() { return m_susceptiblePhase; }
@@ -165,13 +167,12 @@ class AgeData
         unsigned int GetRecoveredPhase()   { return m_recoveredPhase;   }
 
         PopType& GetType() { return m_popType; }
+        unsigned int GetAge() { return m_age; }
 
         // SETTERS
-        void SetNewRecovered(unsigned int q, double value)  { m_newRecoveries.at(q) = value;  }
-        void SetVacFromRec(unsigned int q, double value)    { m_newVacFromRec.at(q) = value;  }
-        void SetNewFatalities(unsigned int q, double value) { m_newFatalities.at(q) = value;  }
-        void SetNewExposed(unsigned int q, double value)    { m_newExposed.at(q)    = value;  }
-        void SetTotalFatalities(double fatals)              { m_totalFatalities     = fatals; }
+        void SetVacFromRec(unsigned int q, scalar value)    { m_newVacFromRec.at(q) = value;  }
+        void SetNewExposed(unsigned int q, scalar value)    { m_newExposed.at(q)    = value;  }
+        void SetTotalFatalities(scalar fatals)              { m_totalFatalities     = fatals; }
 
         /**
          * @brief Sets the value on the specified day
@@ -180,16 +181,16 @@ class AgeData
          * @param q Index
          * @param value New value to set on day q
         */
-        void SetSusceptible(unsigned int q, double value)
+        void SetSusceptible(unsigned int q, scalar value)
         {
-            m_susceptible.at(q) = value;
+            m_changes.write(m_susceptible.at(q), value);
             m_totalSusceptible += value;
         }
 
-        void AddSusceptibleBack(double value)
+        void AddSusceptibleBack(scalar value)
         {
-            m_susceptible.back() += value;
-            m_totalSusceptible   += value;
+            m_changes.write(m_susceptible.back(), m_susceptible.back() + value);
+            m_totalSusceptible += value;
         }
 
         /**
@@ -199,9 +200,9 @@ class AgeData
          * @param q Index
          * @param value New value to set on day q
         */
-        void SetExposed(unsigned int q, double value)
+        void SetExposed(unsigned int q, scalar value)
         {
-            m_exposed.at(q) = value;
+            m_changes.write(m_exposed.at(q), value);
             m_totalExposed += value;
         }
 
@@ -212,9 +213,9 @@ class AgeData
          * @param q Index
          * @param value New value to set on day q
         */
-        void SetInfected(unsigned int q, double value)
+        void SetInfected(unsigned int q, scalar value)
         {
-            m_infected.at(q) = value;
+            m_changes.write(m_infected.at(q), value);
             m_totalInfected += value;
         }
 
@@ -225,9 +226,9 @@ class AgeData
          * @param q Index
          * @param value New value to set on day q
         */
-        void SetRecovered(unsigned int q, double value)
+        void SetRecovered(unsigned int q, scalar value)
         {
-            m_recovered.at(q)  = value;
+            m_changes.write(m_recovered.at(q), value);
             m_totalRecoveries += value;
         }
 };
@@ -0,0 +1,214 @@
+#ifndef PANDEMIC_HOYA_2002_AGE_INNER_KERNEL_HPP
+#define PANDEMIC_HOYA_2002_AGE_INNER_KERNEL_HPP
+
+#include <vector>
+#include "sevirds.hpp"
+#include "simulation_config.hpp"
+
+using namespace std;
+
+/**
+ * The exposed, infected and recovered equations of geographical_cell with the age groups innermost
+ * (config "cell_kernel": "age_inner").
+ *
+ * The equations of each phase are the same for every age group, only the rates differ. The phases of
+ * a population type are copied into arrays where the age group is the contiguous dimension, x[q * A + a],
+ * and each day of a phase is then computed for all the age groups in one loop the compiler vectorizes,
+ * with the rates laid out the same way in the config (see simulation_config::age_inner). The results
+ * are copied back into the state.
+ *
+ * Every age group goes through the same operations, in the same order, as in geographical_cell's
+ * advance_exposed(), advance_infected() and advance_recovered(). All the age groups must have the same
+ * number of phases.
+*/
+class age_inner_kernel
+{
+    public:
+        /**
+         * @brief Advances one population type (non-vaccinated, dose 1 or dose 2) of every age group by a day
+         *
+         * @param rates Rates of the population type
+         * @param new_exposed People exposed today in each age group, who start on the first day of the exposed phase
+         * @param vac_from_rec People vaccinated out of each day of the recovered phase, [q * A + a]. Empty if nobody is
+         * @param fatality_modifier Multiplies the fatality rates (the hospitals are full)
+         * @param reSusceptibility Whether the recovered become susceptible again after the last day
+         * @param exposed Exposed phases of the state, [a][q]
+         * @param infected Infected phases of the state, [a][q]
+         * @param recovered Recovered phases of the state, [a][q]
+         * @param new_s Remaining susceptibles of each age group, minus the exposed, infected and recovered of the population type
+         * @param fatalities Fatalities of each age group, plus the new ones
+         * @param changes Measures how far the proportions of the state move
+        */
+        static void advance(simulation_config::age_inner_rates const& rates, vector<scalar> const& new_exposed,
+                            vector<scalar> const& vac_from_rec, scalar const& fatality_modifier, bool reSusceptibility,
+                            sevirds::proportionVector& exposed, sevirds::proportionVector& infected,
+                            sevirds::proportionVector& recovered, vector<scalar>& new_s, vector<proportion>& fatalities,
+                            change_meter& changes)
+        {
+            unsigned int const A = new_exposed.size();
+            unsigned int const Te = exposed.at(0).size() - 1, Ti = infected.at(0).size() - 1, Tr = recovered.at(0).size() - 1;
+
+            // Reused from one call to the next (one set per thread)
+            static thread_local vector<scalar> E, I, R, next, new_inf, new_rec, new_f, total_e, total_i, total_r;
+            gather(exposed, E);
+            gather(infected, I);
+            gather(recovered, R);
+            next.assign(max(max(Te, Ti), Tr) * A + A, 0.0);
+            new_inf.assign(A, 0.0);
+            new_f.assign(A, 0.0);
+            total_e.assign(A, 0.0);
+            total_i.assign(A, 0.0);
+            total_r.assign(A, 0.0);
+            new_rec.resize(A);
+
+            scalar const* incubation = rates.incubation.data();
+            scalar const* recovery   = rates.recovery.data();
+            scalar const* fatality   = rates.fatality.data();
+
+            // <EXPOSED> Those who move early to the infected phase and those on the last day; the rest move to the next day
+                for (unsigned int q = 0; q <= Te; ++q)
+                {
+                    scalar const* rate  = incubation + q * A;
+                    scalar const* expos = E.data() + q * A;
+                    scalar* to          = next.data() + (q + 1) * A;
+
+                    if (q > 0)
+                    {
+                        for (unsigned int a = 0; a < A; ++a)
+                            new_inf[a] += rate[a] * expos[a];
+                    }
+
+                    if (q < Te)
+                    {
+                        for (unsigned int a = 0; a < A; ++a)
+                        {
+                            to[a]       = (1 - rate[a]) * expos[a];
+                            total_e[a] += to[a];
+                        }
+                    }
+                }
+
+                for (unsigned int a = 0; a < A; ++a)
+                {
+                    next[a]     = new_exposed[a];
+                    total_e[a] += new_exposed[a];
+                }
+                scatter(next, Te, exposed, changes);
+            // </EXPOSED>
+
+            // <INFECTED> fa(q) die, γ(q) recover early and the rest move to the next day; the rest of the last day recovers
+                for (unsigned int a = 0; a < A; ++a)
+                {
+                    scalar const last = I[Ti * A + a];
+                    new_rec[a] = last - fatality[Ti * A + a] * last * fatality_modifier;
+                }
+
+                for (unsigned int q = 0; q <= Ti; ++q)
+                {
+                    scalar const* fa  = fatality + q * A;
+                    scalar const* gam = recovery + q * A;
+                    scalar const* inf = I.data() + q * A;
+                    scalar* to        = next.data() + (q + 1) * A;
+
+                    if (q < Ti)
+                    {
+                        for (unsigned int a = 0; a < A; ++a)
+                        {
+                            scalar const dead = fa[a] * inf[a] * fatality_modifier;
+                            scalar const rec  = gam[a] * inf[a];
+                            new_f[a]   += dead;
+                            new_rec[a] += rec;
+                            to[a]       = inf[a] - dead - rec;
+                            total_i[a] += to[a];
+                        }
+                    }
+                    else
+                    {
+                        for (unsigned int a = 0; a < A; ++a)
+                            new_f[a] += fa[a] * inf[a] * fatality_modifier;
+                    }
+                }
+
+                for (unsigned int a = 0; a < A; ++a)
+                {
+                    next[a]     = new_inf[a];
+                    total_i[a] += new_inf[a];
+                }
+                scatter(next, Ti, infected, changes);
+            // </INFECTED>
+
+            // <RECOVERED> Each day is the previous one minus those who got vaccinated
+                for (unsigned int q = Tr; q > 0; --q)
+                {
+                    scalar const* rec = R.data() + (q - 1) * A;
+                    scalar const* vac = vac_from_rec.empty() ? nullptr : vac_from_rec.data() + (q - 1) * A;
+                    scalar* to        = next.data() + q * A;
+
+                    if (vac)
+                    {
+                        for (unsigned int a = 0; a < A; ++a)
+                            to[a] = rec[a] - vac[a];
+                    }
+                    else
+                    {
+                        for (unsigned int a = 0; a < A; ++a)
+                            to[a] = rec[a];
+                    }
+
+                    // When resusceptibility is off those on the last day stay there
+                    if (!reSusceptibility && q == Tr)
+                    {
+                        scalar const* end = R.data() + Tr * A;
+                        for (unsigned int a = 0; a < A; ++a)
+                            to[a] = end[a] + to[a];
+                    }
+
+                    for (unsigned int a = 0; a < A; ++a)
+                        total_r[a] += to[a];
+                }
+
+                for (unsigned int a = 0; a < A; ++a)
+                {
+                    next[a]     = new_rec[a];
+                    total_r[a] += new_rec[a];
+                }
+                scatter(next, Tr, recovered, changes);
+            // </RECOVERED>
+
+            // S = 1 - E - I - R - F
+            for (unsigned int a = 0; a < A; ++a)
+            {
+                new_s[a] -= total_e[a];
+                new_s[a] -= total_i[a];
+                new_s[a] -= total_r[a];
+                changes.write(fatalities[a], fatalities[a] + new_f[a]);
+            }
+        }
+
+    private:
+        // x[q * A + a] = phases[a][q]
+        static void gather(sevirds::proportionVector const& phases, vector<scalar>& x)
+        {
+            unsigned int const A = phases.size(), T = phases.at(0).size();
+            x.resize(T * A);
+            for (unsigned int a = 0; a < A; ++a)
+            {
+                AssertLong(phases[a].size() == T, __FILE__, __LINE__, "The \"age_inner\" cell_kernel needs the same phases in every age group");
+                for (unsigned int q = 0; q < T; ++q)
+                    x[q * A + a] = phases[a][q];
+            }
+        }
+
+        // phases[a][q] = x[q * A + a], for q up to last
+        static void scatter(vector<scalar> const& x, unsigned int last, sevirds::proportionVector& phases, change_meter& changes)
+        {
+            unsigned int const A = phases.size();
+            for (unsigned int a = 0; a < A; ++a)
+            {
+                for (unsigned int q = 0; q <= last; ++q)
+                    changes.write(phases[a][q], x[q * A + a]);
+            }
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_AGE_INNER_KERNEL_HPP
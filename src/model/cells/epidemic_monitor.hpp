@@ -0,0 +1,105 @@
+#ifndef PANDEMIC_HOYA_2002_EPIDEMIC_MONITOR_HPP
+#define PANDEMIC_HOYA_2002_EPIDEMIC_MONITOR_HPP
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include "sevirds.hpp"
+#include "../Helpers/Summation.hpp"
+
+using namespace std;
+
+/**
+ * Tells when the epidemic of a run is over (config "early_stop"), so the run can stop before its last day. Each cell
+ * reports its state whenever it changes, and after each day the runner asks whether either criterion holds:
+ *  - extinction: fewer than "below" people are exposed or infected in the whole model
+ *  - steady state: for "steady_days" days in a row, no compartment of any cell changed by more than "tolerance" people
+*/
+class epidemic_monitor
+{
+    public:
+        epidemic_monitor(double below, unsigned int steady_days, double tolerance) :
+            below{below}, steady_days{steady_days}, tolerance{tolerance} { }
+
+        // Adds a cell and returns its row, which it reports with
+        unsigned int add_cell()
+        {
+            cells.emplace_back();
+            active.push_back(0);
+            return cells.size() - 1;
+        }
+
+        /**
+         * @brief Records the new state of a cell
+         *
+         * @param row Row of the cell
+         * @param state New state of the cell
+        */
+        void report(unsigned int row, sevirds const& state)
+        {
+            compartments_type next{};
+            double const exposed_infected = add_compartments(state, next);
+
+            double change = 0;
+            for (unsigned int k = 0; k < next.size(); ++k)
+                change += abs(next[k] - cells.at(row)[k]);
+
+            largest_change = max(largest_change, change);
+            cells.at(row)  = next;
+            active.at(row) = exposed_infected;
+        }
+
+        /**
+         * @brief Closes the day whose states were all reported
+         *
+         * @return bool Whether the epidemic is over and the run can stop
+        */
+        bool end_day()
+        {
+            Summation::sum<double> total = 0;
+            for (double people : active)
+                total += people;
+            exposed_infected = total;
+
+            steady_count     = largest_change <= tolerance ? steady_count + 1 : 0;
+            largest_change   = 0;
+
+            return exposed_infected < below || (steady_days > 0 && steady_count >= steady_days);
+        }
+
+        // People exposed or infected in the whole model at the end of the last day closed
+        double exposed_or_infected() const { return exposed_infected; }
+
+        // Whether the last end_day() stopped for the steady state rather than the extinction
+        bool steady() const { return exposed_infected >= below; }
+
+    private:
+        // Susceptible, exposed, infected, recovered and dead people of a cell, vaccinated or not
+        using compartments_type = array<double, 5>;
+
+        double below;
+        unsigned int steady_days;
+        double tolerance;
+
+        vector<compartments_type> cells; // Compartments of each cell, from its last report
+        vector<double> active;           // Exposed and infected people of each cell, from its last report
+        double largest_change   = 0;     // Largest change of a cell since the last end_day()
+        double exposed_infected = 0;
+        unsigned int steady_count = 0;   // Days in a row without a change above the tolerance
+
+        // Adds the compartments of a state to a cell's and returns its exposed and infected people
+        static double add_compartments(sevirds const& state, compartments_type& compartments)
+        {
+            compartments_type const people = {value_of(state.get_total_susceptible(true)) * state.population,
+                                              value_of(state.get_total_exposed()) * state.population,
+                                              value_of(state.get_total_infections()) * state.population,
+                                              value_of(state.get_total_recovered()) * state.population,
+                                              value_of(state.get_total_fatalities()) * state.population};
+
+            for (unsigned int k = 0; k < people.size(); ++k)
+                compartments[k] += people[k];
+            return people[1] + people[2];
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_EPIDEMIC_MONITOR_HPP
@@ -0,0 +1,292 @@
+#ifndef PANDEMIC_HOYA_2002_FAR_FIELD_HPP
+#define PANDEMIC_HOYA_2002_FAR_FIELD_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "travel_network.hpp"
+#include "../Helpers/Assert.hpp"
+
+using namespace std;
+
+/**
+ * Hierarchical approximation of the travel term of the infection pressure (config "far_field").
+ *
+ * The cells are grouped into clusters, and the clusters into larger ones, by a CSV file with one line per cell:
+ *
+ *     cell,country,continent
+ *
+ * (any number of levels, from the smallest clusters to the largest). The flows reaching a cell are grouped the
+ * same way. Each day, the flows of a group from a cluster that doesn't hold the cell are replaced by their total
+ * correlation W times the mean load of the cluster, as long as that can't be off by more than the tolerance:
+ * the error of a group is at most W * (max load - min load) of its cluster, so the approximation is used when
+ * (max - min) * (total correlation reaching the cell) <= tolerance, and the error on the travel pressure of a cell
+ * never exceeds the tolerance. Otherwise the group is split into its smaller clusters, down to the flows themselves.
+ * The flows from the clusters of the cell itself are always summed exactly.
+*/
+class far_field
+{
+    public:
+        // What the approximation did over the whole simulation
+        struct report_type
+        {
+            unsigned long evaluations = 0; // Travel pressures computed
+            unsigned long terms       = 0; // Groups and flows summed for them
+            unsigned long flows       = 0; // Flows an exact sum would have gone through
+            double max_bound          = 0; // Largest error bound of a travel pressure
+            double max_error          = 0; // Largest difference with the exact sum (when checked)
+            bool checked              = false;
+        };
+
+        far_field() = default;
+
+        explicit far_field(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            string line;
+            unsigned int line_number = 0;
+            while (getline(file, line))
+            {
+                ++line_number;
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || (line_number == 1 && line.rfind("cell,", 0) == 0))
+                    continue;
+
+                stringstream columns{line};
+                string cell_id, cluster;
+                getline(columns, cell_id, ',');
+
+                vector<string> clusters;
+                while (getline(columns, cluster, ','))
+                    clusters.push_back(cluster);
+
+                if (num_levels == 0)
+                    num_levels = clusters.size();
+
+                Assert::AssertLong(!cell_id.empty() && clusters.size() == num_levels && num_levels > 0, __FILE__, __LINE__,
+                                    "Line " + to_string(line_number) + " of " + file_path + " must have a cell and "
+                                    + to_string(max(num_levels, 1u)) + " cluster(s)");
+
+                cell_clusters.emplace(move(cell_id), move(clusters));
+            }
+        }
+
+        /**
+         * @brief Numbers the clusters and groups the flows reaching every cell by cluster
+         *
+         * @param ids Id of the cell of each row
+         * @param travel Flows, already resolved
+        */
+        void build(vector<string> const& ids, travel_network const& travel)
+        {
+            Assert::AssertLong(num_levels > 0, __FILE__, __LINE__, "The far_field clusters are empty");
+            unsigned int const num_rows = ids.size();
+
+            // cluster_of[level][row], with the clusters numbered per level
+            cluster_of.assign(num_levels, vector<unsigned int>(num_rows));
+            vector<unordered_map<string, unsigned int>> numbers(num_levels);
+            for (unsigned int row = 0; row < num_rows; ++row)
+            {
+                auto found = cell_clusters.find(ids.at(row));
+                Assert::AssertLong(found != cell_clusters.end(), __FILE__, __LINE__, "The cell " + ids.at(row) + " isn't in any far_field cluster");
+
+                // The same name on two levels is two clusters, and so is the same name under two parents
+                string path;
+                for (unsigned int level = num_levels; level-- > 0;)
+                {
+                    path += "," + found->second.at(level);
+                    auto inserted = numbers.at(level).insert({path, numbers.at(level).size()});
+                    cluster_of.at(level).at(row) = inserted.first->second;
+                }
+            }
+
+            num_clusters.assign(num_levels, 0);
+            for (unsigned int level = 0; level < num_levels; ++level)
+                num_clusters.at(level) = numbers.at(level).size();
+
+            cell_clusters.clear();
+
+            // The flows of each cell sorted from the largest cluster of their origin down to the origin itself
+            flow_order.resize(travel.origins.size());
+            iota(flow_order.begin(), flow_order.end(), 0);
+            total_weights.assign(num_rows, 0.0);
+            top_begin.clear();
+            top_end.clear();
+            nodes.clear();
+
+            for (unsigned int i = 0; i < num_rows; ++i)
+            {
+                unsigned int const begin = travel.flows_begin.at(i), end = travel.flows_begin.at(i + 1);
+                sort(flow_order.begin() + begin, flow_order.begin() + end, [this, &travel](unsigned int a, unsigned int b)
+                {
+                    for (unsigned int level = num_levels; level-- > 0;)
+                    {
+                        unsigned int const ca = cluster_of[level][travel.origins[a]], cb = cluster_of[level][travel.origins[b]];
+                        if (ca != cb)
+                            return ca < cb;
+                    }
+                    return travel.origins[a] < travel.origins[b];
+                });
+
+                for (unsigned int f = begin; f < end; ++f)
+                    total_weights.at(i) += travel.correlations.at(flow_order.at(f));
+
+                unsigned int const top = nodes.size();
+                top_begin.push_back(top);
+                top_end.push_back(top + add_groups(travel, begin, end, num_levels - 1));
+            }
+
+            means.assign(num_levels, {});
+            spreads.assign(num_levels, {});
+        }
+
+        /**
+         * @brief Updates the mean and spread of the loads of every cluster. Called once per day before evaluate()
+         *
+         * @param loads Load of every cell (0 for those nobody can travel out of)
+        */
+        void update(vector<double> const& loads)
+        {
+            for (unsigned int level = 0; level < num_levels; ++level)
+            {
+                vector<double> sums(num_clusters.at(level), 0.0), lows(num_clusters.at(level), 0.0), highs(num_clusters.at(level), 0.0);
+                vector<unsigned int> counts(num_clusters.at(level), 0);
+
+                for (unsigned int row = 0; row < loads.size(); ++row)
+                {
+                    unsigned int const c = cluster_of[level][row];
+                    lows[c]  = counts[c] == 0 ? loads[row] : min(lows[c], loads[row]);
+                    highs[c] = counts[c] == 0 ? loads[row] : max(highs[c], loads[row]);
+                    sums[c] += loads[row];
+                    ++counts[c];
+                }
+
+                means.at(level).resize(num_clusters.at(level));
+                spreads.at(level).resize(num_clusters.at(level));
+                for (unsigned int c = 0; c < num_clusters.at(level); ++c)
+                {
+                    means[level][c]   = sums[c] / counts[c];
+                    spreads[level][c] = highs[c] - lows[c];
+                }
+            }
+        }
+
+        /**
+         * @brief Approximate travel pressure of a cell: sum(j, Tij * x(j)) within the tolerance
+         *
+         * @param row Row of the cell
+         * @param travel Flows, already resolved
+         * @param loads Load of every cell, as given to update()
+         * @param tolerance Largest error allowed
+         * @return double
+        */
+        double evaluate(unsigned int row, travel_network const& travel, vector<double> const& loads, double tolerance)
+        {
+            double bound = 0, sum = 0;
+            for (unsigned int n = top_begin.at(row); n < top_end.at(row); ++n)
+                sum += evaluate(nodes[n], row, travel, loads, tolerance / total_weights[row], bound);
+
+            ++report.evaluations;
+            report.flows    += travel.flows_begin[row + 1] - travel.flows_begin[row];
+            report.max_bound = max(report.max_bound, bound);
+            return sum;
+        }
+
+        // Records the difference between an approximate travel pressure and the exact one
+        void check(double approximate, double exact)
+        {
+            report.checked   = true;
+            report.max_error = max(report.max_error, abs(approximate - exact));
+        }
+
+        report_type const& get_report() const { return report; }
+
+    private:
+        unsigned int num_levels = 0;
+        unordered_map<string, vector<string>> cell_clusters; // As read, until build()
+
+        vector<vector<unsigned int>> cluster_of;
+        vector<unsigned int> num_clusters;
+        vector<vector<double>> means, spreads;
+
+        // The flows of a cell from one cluster. Its smaller clusters are nodes[children_begin] to nodes[children_end - 1],
+        // and the largest clusters reaching the cell of row i are nodes[top_begin[i]] to nodes[top_end[i] - 1]
+        struct group
+        {
+            unsigned int level, cluster;
+            double weight;
+            unsigned int flow_begin, flow_end;
+            unsigned int children_begin, children_end;
+        };
+        vector<group> nodes;
+        vector<unsigned int> top_begin, top_end;
+        vector<unsigned int> flow_order;
+        vector<double> total_weights;
+
+        report_type report;
+
+        // Adds a group for every cluster of the given level among the flows, then the smaller clusters of each.
+        // Returns the number of groups of the given level, which are next to each other
+        unsigned int add_groups(travel_network const& travel, unsigned int begin, unsigned int end, unsigned int level)
+        {
+            unsigned int const first = nodes.size();
+            for (unsigned int f = begin; f < end;)
+            {
+                unsigned int const cluster = cluster_of[level][travel.origins[flow_order[f]]];
+                group added{level, cluster, 0.0, f, f, 0, 0};
+                for (; f < end && cluster_of[level][travel.origins[flow_order[f]]] == cluster; ++f)
+                    added.weight += travel.correlations[flow_order[f]];
+                added.flow_end = f;
+                nodes.push_back(added);
+            }
+
+            unsigned int const last = nodes.size();
+            for (unsigned int n = first; n < last && level > 0; ++n)
+            {
+                unsigned int const children = nodes.size();
+                unsigned int const count    = add_groups(travel, nodes[n].flow_begin, nodes[n].flow_end, level - 1);
+                nodes[n].children_begin = children;
+                nodes[n].children_end   = children + count;
+            }
+
+            return last - first;
+        }
+
+        double evaluate(group const& node, unsigned int row, travel_network const& travel, vector<double> const& loads,
+                        double max_spread, double& bound)
+        {
+            double const spread = spreads[node.level][node.cluster];
+            if (node.cluster != cluster_of[node.level][row] && spread <= max_spread)
+            {
+                ++report.terms;
+                bound += node.weight * spread;
+                return node.weight * means[node.level][node.cluster];
+            }
+
+            double sum = 0;
+            if (node.level == 0)
+            {
+                report.terms += node.flow_end - node.flow_begin;
+                for (unsigned int f = node.flow_begin; f < node.flow_end; ++f)
+                    sum += travel.correlations[flow_order[f]] * loads[travel.origins[flow_order[f]]];
+            }
+            else
+            {
+                for (unsigned int n = node.children_begin; n < node.children_end; ++n)
+                    sum += evaluate(nodes[n], row, travel, loads, max_spread, bound);
+            }
+
+            return sum;
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_FAR_FIELD_HPP
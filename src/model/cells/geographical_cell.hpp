@@ -7,14 +7,23 @@
 
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <cadmium/celldevs/cell/cell.hpp>
 #include <iomanip>
 #include "vicinity.hpp"
 #include "sevirds.hpp"
+#include "hysteresis_factor.hpp"
+#include "pressure_engine.hpp"
+#include "sensitivity_log.hpp"
+#include "region_series.hpp"
+#include "epidemic_monitor.hpp"
+#include "timeline.hpp"
 #include "simulation_config.hpp"
 #include "AgeData.hpp"
+#include "age_inner_kernel.hpp"
 #include "../Helpers/Assert.hpp"
+#include "../Helpers/Random.hpp"
 
 using namespace std;
 using namespace cadmium::celldevs;
@@ -41,75 +50,223 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
 
         using config_type = simulation_config;
 
-        using phase_rates = vector<     // The age sub_division
-                            vecDouble>; // The stage of infection
-
-        phase_rates virulence_rates;
-        phase_rates incubationD1_rates;
-        phase_rates incubationD2_rates;
-        phase_rates incubation_rates;
-        phase_rates recovery_rates;
-        phase_rates recoveryD1_rates;
-        phase_rates recoveryD2_rates;
-        phase_rates mobility_rates;
-        phase_rates fatality_rates;
-        phase_rates fatalityD1_rates;
-        phase_rates fatalityD2_rates;
-        phase_rates vac1_rates;
-        phase_rates vac2_rates;
-
         // To make the parameters of the correction_factors variable more obvious
         using infection_threshold        = float;
         using mobility_correction_factor = array<float, 2>;  // array<mobility correction factor, hysteresis factor>;
 
-        bool reSusceptibility, is_vaccination;
-        string travel_restriction;
+        bool is_vaccination;
 
         unsigned int age_segments;
 
+        shared_ptr<pressure_engine<T>> engine;
+        unsigned int engine_row = 0;
+
+        // The kernel and the infection pressure of the config, compared once instead of on every step
+        bool spmv_pressure = false, inner_kernel = false;
+
+        unsigned int self_edge = 0; // Index of the cell itself in the neighbors vector
+
+        // Daily totals and their derivatives (config "sensitivity"), which the cell reports its state to whenever it changes
+        shared_ptr<sensitivity_log> sensitivity;
+        unsigned int sensitivity_row = 0;
+
+        // Totals of the observed regions (see calibration.hpp), which the cell reports its state to if it's one of them
+        shared_ptr<region_series> series;
+        int series_row = -1;
+
+        // Tells when the epidemic is over (config "early_stop"), which the cell reports its state to whenever it changes
+        shared_ptr<epidemic_monitor> monitor;
+        unsigned int monitor_row = 0;
+
+        // Dated changes of the config and of the states (config "timeline", see follow_timeline())
+        shared_ptr<timeline const> events;
+
+        // Stochastic transitions (config "stochastic")
+        bool stochastic = false;
+
+        struct received_state
+        {
+            unsigned long version;
+            shared_ptr<infectious_summary const> summary;
+        };
+
+        /**
+         * What the cell carries from one computation to the next besides its state. Cadmium hands local_computation()
+         * a const cell and only keeps the states it sends, so this is the one part of the cell a computation changes
+        */
+        struct carried
+        {
+            // Rate tables shared by every cell built from the same config (see geographical_coupled::shared_config()):
+            // one immutable copy per distinct config instead of one per cell.
+            // With a timeline the cell moves on to the config of each stage on its day (see follow_timeline())
+            shared_ptr<config_type const> config;
+
+            // Hysteresis of the movement restriction towards each neighbor, in the order of the neighbors vector.
+            // It goes along with the state Cadmium keeps (see next_state())
+            vector<hysteresis_factor> hysteresis;
+
+            // With the config's state_change_tolerance: the neighbors keep reading the summary of the last state they were shown
+            // while the largest moves of the days since then add up to at most the tolerance, which bounds how far any proportion
+            // got from it. Whether the last computation left the state as it was without any random travelers, and the summaries
+            // it read then (see repeats_itself())
+            double drift = 0;
+            bool settled = false, drew_travelers = false;
+            vector<shared_ptr<infectious_summary const>> read_summaries;
+
+            // The next stage and state change of the timeline to reach
+            unsigned int next_stage = 1, next_change = 0;
+
+            // A settled cell sends nothing, so it sends its state again to reach the day of its next event (see wake_up()).
+            // That state may reach the neighbors after newer ones, so with a timeline they keep the newest state received
+            // from each neighbor (see gather_neighbors())
+            double wake_day = -1;
+            T delay = 1;
+            vector<received_state> received;
+
+            // Modifiers given to the cell between two days of the run (see modify_state()), until it computes its next state
+            vector<nlohmann::json> queued_modifiers;
+        };
+        mutable carried memory;
+
+        // What the kernel reads of each neighbor, in the order of the neighbors vector. Gathered once at
+        // the start of local_computation() so that the neighbors aren't looked up by id on every equation
+        struct neighbor_view
+        {
+            infectious_summary const* summary;
+            vicinity const* link;
+        };
+
+        /**
+         * What a single computation of the next state works with, passed down to the equations by reference
+         * (see local_computation() and aged())
+        */
+        struct computation
+        {
+            vector<neighbor_view> neighbor_views;
+
+            // The hysteresis updated while computing the next state, which becomes the cell's when the state is accepted
+            vector<hysteresis_factor> next_hysteresis;
+
+            // Whether the EIRD equations can be skipped (see is_quiescent())
+            bool quiescent = false;
+
+            // Multiplies the fatality rates of the day, from the infections at its start (see fatality_modifier())
+            scalar fatality_modifier = 1.0;
+
+            // Sum over the neighbors of new_exposed() for each age group b of the neighbors, which is the same for every
+            // equation of a day. Computed once at the start of the computation, by the engine with "spmv" or a travel network
+            vector<Summation::sum<scalar>> infectious;
+
+            // Force of infection on each age group a of the cell: sum(b, C(a, b) * infectious(b)) with the config's
+            // contact_matrix C, or sum(b, infectious(b)) without one (where infectious(b) also counts the infected of b' < b)
+            vector<scalar> infection_pressure;
+
+            // The state changes of the timeline for this cell on the day, and whether a stage starts on it
+            vector<timeline::state_change const*> due_changes;
+            bool new_stage = false;
+
+            // How far the equations moved the proportions of the state (see next_state())
+            change_meter changes;
+
+            // Stochastic transitions: the random numbers of the day, and the people of the age group being computed
+            Random::counter_stream draws;
+            double people = 0;
+            scalar vaccinated_susceptible = 0; // S(1) of the age group vaccinated today, who can't be exposed as well
+
+            // Set while aged() moves the state forward, which leaves the travel out
+            bool aging = false;
+        };
+
         geographical_cell() : cell<T, string, sevirds, vicinity>() {}
 
         geographical_cell(string const& cell_id, cell_unordered<vicinity> const& neighborhood,
-                            sevirds const& initial_state, string const& delay_id, simulation_config config) :
-            cell<T, string, sevirds, vicinity>(cell_id, neighborhood, initial_state, delay_id)
+                            sevirds const& initial_state, string const& delay_id, shared_ptr<config_type const> shared_config,
+                            shared_ptr<pressure_engine<T>> shared_engine = nullptr, shared_ptr<sensitivity_log> shared_sensitivity = nullptr,
+                            shared_ptr<region_series> shared_series = nullptr, shared_ptr<epidemic_monitor> shared_monitor = nullptr,
+                            shared_ptr<timeline const> shared_timeline = nullptr) :
+            cell<T, string, sevirds, vicinity>(cell_id, neighborhood, initial_state, delay_id),
+            engine{move(shared_engine)},
+            sensitivity{move(shared_sensitivity)},
+            series{move(shared_series)},
+            monitor{move(shared_monitor)},
+            events{move(shared_timeline)}
         {
-            for (const auto& i : neighborhood)
-                state.current_state.hysteresis_factors.insert({i.first, hysteresis_factor{}});
+            memory.config = move(shared_config);
+            shared_ptr<config_type const> const& config = memory.config;
+
+            memory.hysteresis.assign(neighbors.size(), hysteresis_factor{});
+            self_edge = distance(neighbors.begin(), find(neighbors.begin(), neighbors.end(), cell_id));
+            AssertLong(self_edge < neighbors.size(), __FILE__, __LINE__, "The cell " + cell_id + " must be part of its own neighborhood");
+            AssertLong(!events || events->get_stages().front().config == config, __FILE__, __LINE__,
+                        "The timeline of the cell " + cell_id + " must start from its config");
 
             // Set whether or not vaccines are being modeled
             // to be used in the getters found in sevirds.hpp
             // and later in this file
-            is_vaccination               = config.is_vaccination;
+            is_vaccination               = config->is_vaccination;
             state.current_state.vaccines = is_vaccination;
-            travel_restriction = config.travel_restriction;
+            spmv_pressure      = config->infection_pressure == "spmv";
+            inner_kernel       = config->cell_kernel == "age_inner";
+            stochastic         = config->stochastic;
 
             // Set the precision divider in the sevirds object
-            state.current_state.prec_divider          = (double)config.prec_divider;
-            state.current_state.one_over_prec_divider = 1.0 / (double)config.prec_divider;
-
-            virulence_rates  = move(config.virulence_rates);
-            incubation_rates = move(config.incubation_rates);
-            recovery_rates   = move(config.recovery_rates);
-            mobility_rates   = move(config.mobility_rates);
-            fatality_rates   = move(config.fatality_rates);
+            state.current_state.prec_divider          = (double)config->prec_divider;
+            state.current_state.one_over_prec_divider = 1.0 / (double)config->prec_divider;
 
-            // Multiplication is always faster then division so set this up to be 1/prec_divider to be multiplied later
-            reSusceptibility  = config.reSusceptibility;
             age_segments = initial_state.get_num_age_segments();
 
-            if (is_vaccination)
+            AssertLong(config->contact_matrix.empty() || age_segments <= config->contact_matrix.size(), __FILE__, __LINE__,
+                        "The cell " + cell_id + " has more age groups than the contact_matrix");
+
+            if (inner_kernel)
             {
-                vac1_rates = move(config.vac1_rates);
-                vac2_rates = move(config.vac2_rates);
+                sevirds const& initial = state.current_state;
+                AssertLong(age_segments == config->virulence_rates.size()
+                            && initial.exposed->at(0).size() <= config->incubation_rates.at(0).size()
+                            && initial.infected->at(0).size() <= config->recovery_rates.at(0).size()
+                            && initial.exposedD1->at(0).size() <= config->incubationD1_rates.at(0).size()
+                            && initial.infectedD1->at(0).size() <= config->recovery_ratesD1.at(0).size()
+                            && initial.exposedD2->at(0).size() <= config->incubationD2_rates.at(0).size()
+                            && initial.infectedD2->at(0).size() <= config->recovery_ratesD2.at(0).size(),
+                            __FILE__, __LINE__, "The \"age_inner\" cell_kernel needs the rates of every phase of every age group of " + cell_id);
+            }
 
-                incubationD1_rates = move(config.incubationD1_rates);
-                incubationD2_rates = move(config.incubationD2_rates);
+            // The derivatives of the modifiers of the states start before anything reads them
+            if (!config->sensitivity.empty())
+            {
+                state.current_state.seed_sensitivity(config->sensitivity);
+                for (auto& neighbor_state : state.neighbors_state)
+                    neighbor_state.second.seed_sensitivity(config->sensitivity);
+            }
 
-                recoveryD1_rates = move(config.recovery_ratesD1);
-                recoveryD2_rates = move(config.recovery_ratesD2);
+            // The neighbors only read the summaries of the states (see infectious_summary.hpp)
+            state.current_state.summarize();
+            for (auto& neighbor_state : state.neighbors_state)
+                neighbor_state.second.summarize();
 
-                fatalityD1_rates = move(config.fatality_ratesD1);
-                fatalityD2_rates = move(config.fatality_ratesD2);
+            if (engine)
+            {
+                engine_row = engine->add_cell(cell_id, neighbors, neighborhood, config);
+                engine->publish(engine_row, state.current_state.summary, 0);
+            }
+
+            if (sensitivity)
+            {
+                sensitivity_row = sensitivity->add_cell();
+                sensitivity->report(sensitivity_row, 0, state.current_state);
+            }
+
+            if (series)
+            {
+                series_row = series->row_of(cell_id);
+                if (series_row >= 0)
+                    series->report(series_row, state.current_state);
+            }
+
+            if (monitor)
+            {
+                monitor_row = monitor->add_cell();
+                monitor->report(monitor_row, state.current_state);
             }
         }
 
@@ -121,10 +278,165 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          * @return sevirds
         */
         sevirds local_computation() const override
+        {
+            computation step = start_computation();
+            memory.delay = 1;
+            follow_timeline(step);
+            gather_neighbors(step);
+
+            if (repeats_itself(step))
+                return state.current_state;
+
+            sevirds res = next_state(step, state.current_state);
+            memory.queued_modifiers.clear();
+
+            if (monitor && res.version != state.current_state.version)
+                monitor->report(monitor_row, res);
+            return res;
+        } //local_computation()
+
+        /**
+         * @brief The current state of the cell some days later if nothing infects it anymore:
+         * the same equations without any infection pressure or travel, so only the recovered, vaccinated and
+         * remaining exposed and infected phases move forward (see the "fast_forward" of the config's early_stop)
+         *
+         * @param days Number of days
+         * @return sevirds
+        */
+        sevirds aged(unsigned int days) const
+        {
+            sevirds res = state.current_state;
+            computation step = start_computation();
+            step.aging = true;
+
+            for (unsigned int day = 0; day < days; ++day)
+            {
+                if (stochastic)
+                    step.draws = Random::counter_stream::start();
+                step.quiescent = res.is_infection_free();
+
+                if (inner_kernel)
+                    compute_age_inner(step, res);
+                else
+                    compute_age_outer(step, res);
+            }
+            res.summarize();
+
+            ++res.version;
+            return res;
+        }
+
+        // A new computation, without any infection pressure yet
+        computation start_computation() const
+        {
+            computation step;
+            step.infectious.assign(memory.config->virulence_rates.size(), 0.0);
+            step.infection_pressure.assign(age_segments, 0.0);
+            return step;
+        }
+
+        /**
+         * @brief Computes the next state of the cell from the neighbor_views
+         *
+         * @param step The computation
+         * @param current Current state
+         * @return sevirds
+        */
+        sevirds next_state(computation& step, sevirds const& current) const
         {
             // Can't be a reference since it would need to be
             // const and then we wouldn't be allowed to change its values
-            sevirds res = state.current_state;
+            sevirds res = current;
+            step.next_hysteresis = memory.hysteresis;
+            memory.drew_travelers = false;
+
+            if (stochastic)
+                step.draws = Random::counter_stream::start();
+
+            // Nothing but the vaccinations can change in a cell without any exposed, infected or recovered
+            // and without infectious neighbors, so the EIRD equations are skipped until one shows up
+            step.quiescent = is_quiescent(step, current);
+
+            if (spmv_pressure)
+            {
+                double const* border = engine->pressure(engine_row, simulation_clock);
+                step.infectious.assign(border, border + step.infectious.size());
+            }
+            else
+                neighborhood_pressure(step, res);
+
+            // Long-range travel from cells that may not be neighbors (see travel_network.hpp)
+            if (engine && engine->has_travel())
+            {
+                double const* travel = engine->travel_pressure(engine_row, simulation_clock);
+                for (unsigned int age_group = 0; age_group < step.infectious.size(); ++age_group)
+                {
+                    step.infectious[age_group] += travel[age_group];
+                    step.quiescent = step.quiescent && travel[age_group] == 0;
+                }
+            }
+
+            contact_pressure(step);
+
+            if (inner_kernel)
+                compute_age_inner(step, res);
+            else
+                compute_age_outer(step, res);
+
+            // The modifiers of the day go out with the new state, so the cell and its neighbors use them from the next day on
+            for (timeline::state_change const* change : step.due_changes)
+                patch_modifiers(change->modifiers, res);
+            for (nlohmann::json const& modifiers : memory.queued_modifiers)
+                patch_modifiers(modifiers, res);
+
+            // Stamp the state as changed, which the equations measured as they wrote it, so neither this nor
+            // the comparisons Cadmium makes afterwards go through the phases. The modifiers of the day always go out,
+            // and a cell that settles before an event of its timeline wakes up on its day
+            memory.settled = step.changes.largest == 0 && !in_timeline(step);
+            if (!memory.settled)
+            {
+                ++res.version;
+
+                // With an inertial delay this state replaces the one wake_up() sent, so the cell must send it again once settled
+                memory.wake_day = -1;
+
+                // Cadmium keeps the new state, and the hysteresis goes along with it
+                swap(memory.hysteresis, step.next_hysteresis);
+
+                // Cadmium only keeps a state it sends, so every change is sent. Within the state_change_tolerance
+                // of the state the neighbors were last shown, they go on reading its summary (res kept it)
+                double const tolerance = memory.config->state_change_tolerance;
+                memory.drift += step.changes.largest;
+                if (tolerance <= 0 || memory.drift > tolerance || in_timeline(step))
+                {
+                    res.summarize();
+                    memory.drift = 0;
+
+                    if (engine)
+                        engine->publish(engine_row, res.summary, simulation_clock + output_delay(res));
+                }
+
+                if (sensitivity)
+                    sensitivity->report(sensitivity_row, simulation_clock, res);
+
+                if (series_row >= 0)
+                    series->report(series_row, res);
+            }
+            else if (events)
+                wake_up(res);
+
+            return res;
+        } //next_state()
+
+        /**
+         * @brief Computes the next state of every age group, one age group after the other
+         *
+         * @param step The computation
+         * @param res Next state of the cell
+        */
+        void compute_age_outer(computation& step, sevirds& res) const
+        {
+            step.fatality_modifier = fatality_modifier(res);
 
             // Number of AgeData objects needed
             // One for non-vac, dose1, dose2, and any booster shot populations
@@ -140,34 +452,36 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
             // Global new susceptible variable as the other equations
             // remove their proportions from this one leaving it with
             // the remaning susceptible proportion
-            double new_s;
+            scalar new_s;
 
             // Calculate the next new sevirds variables for each age group
             for (unsigned int age_segment_index = 0; age_segment_index < age_segments; ++age_segment_index)
             {
                 // Reset for susceptible equation
                 new_s = 1;
+                step.people = res.population * res.age_group_proportions->at(age_segment_index);
+                step.vaccinated_susceptible = 0;
 
                 // Init the non-vac object for the current age group
-                datas.at(NVAC).reset(new AgeData(age_segment_index, res.susceptible, res.exposed, res.infected,
-                                                res.recovered, incubation_rates, recovery_rates, fatality_rates));
+                datas.at(NVAC).reset(new AgeData(step.changes, age_segment_index, res.susceptible.edit(), res.exposed.edit(), res.infected.edit(),
+                                                res.recovered.edit(), memory.config->incubation_rates, memory.config->recovery_rates, memory.config->fatality_rates));
 
 
                 if (is_vaccination)
                 {
                     // Init the vac object for the current age group
-                    datas.at(VAC1).reset(new AgeData(age_segment_index, res.vaccinatedD1, res.exposedD1, res.infectedD1,
-                                                    res.recoveredD1, incubationD1_rates, recoveryD1_rates,
-                                                    fatalityD1_rates, vac1_rates.at(age_segment_index),
-                                                    res.immunityD1_rate.at(age_segment_index), AgeData::PopType::DOSE1));
-                    datas.at(VAC2).reset(new AgeData(age_segment_index, res.vaccinatedD2, res.exposedD2, res.infectedD2,
-                                                    res.recoveredD2, incubationD2_rates, recoveryD2_rates,
-                                                    fatalityD2_rates, vac2_rates.at(age_segment_index),
-                                                    res.immunityD2_rate.at(age_segment_index), AgeData::PopType::DOSE2));
+                    datas.at(VAC1).reset(new AgeData(step.changes, age_segment_index, res.vaccinatedD1.edit(), res.exposedD1.edit(), res.infectedD1.edit(),
+                                                    res.recoveredD1.edit(), memory.config->incubationD1_rates, memory.config->recovery_ratesD1,
+                                                    memory.config->fatality_ratesD1, memory.config->vac1_rates.at(age_segment_index),
+                                                    res.immunityD1_rate->at(age_segment_index), AgeData::PopType::DOSE1));
+                    datas.at(VAC2).reset(new AgeData(step.changes, age_segment_index, res.vaccinatedD2.edit(), res.exposedD2.edit(), res.infectedD2.edit(),
+                                                    res.recoveredD2.edit(), memory.config->incubationD2_rates, memory.config->recovery_ratesD2,
+                                                    memory.config->fatality_ratesD2, memory.config->vac2_rates.at(age_segment_index),
+                                                    res.immunityD2_rate->at(age_segment_index), AgeData::PopType::DOSE2));
 
                     // Equations for Vaccinated population (eg. EV1, RV2...)
 //                    sanity_check(res.get_total_susceptible(true, age_segment_index), __LINE__);
-                    compute_vaccinated(datas, res);
+                    compute_vaccinated(step, datas, res);
 
                     // S = 1 - V1 - V2
                     new_s -= datas.at(VAC1).get()->GetTotalSusceptible(); // 1e
@@ -177,64 +491,171 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 }
 
                 // Compute the Exposed, Infected, Recovered, and Fatalities equations
-                // for all population types
-                compute_EIRD(datas, res);
-
-                // S = 1 - E - I - R - F
-                for (unique_ptr<AgeData>& data : datas)
+                // for all population types. They would all stay at 0 in a quiescent cell
+                if (!step.quiescent)
                 {
-                    new_s -= data.get()->GetTotalExposed();
-                    sanity_check(new_s, __LINE__);
-                    new_s -= data.get()->GetTotalInfected();
-                    sanity_check(new_s, __LINE__);
-                    new_s -= data.get()->GetTotalRecovered();
+                    compute_EIRD(step, datas);
 
-                    res.fatalities.at(age_segment_index) += data.get()->GetTotalFatalities();
-                    sanity_check(res.fatalities.at(age_segment_index), __LINE__);
+                    // S = 1 - E - I - R - F
+                    for (unique_ptr<AgeData>& data : datas)
+                    {
+                        new_s -= data.get()->GetTotalExposed();
+                        sanity_check(new_s, __LINE__);
+                        new_s -= data.get()->GetTotalInfected();
+                        sanity_check(new_s, __LINE__);
+                        new_s -= data.get()->GetTotalRecovered();
+
+                        proportion& fatalities = res.fatalities.edit().at(age_segment_index);
+                        step.changes.write(fatalities, fatalities + data.get()->GetTotalFatalities());
+                        sanity_check(res.fatalities->at(age_segment_index), __LINE__);
+                    }
                 }
 
-                new_s -= res.fatalities.at(age_segment_index);
+                new_s -= res.fatalities->at(age_segment_index);
                 sanity_check(new_s, __LINE__);
 
 //                travel_international(res,age_segment_index,new_s);
 
 //                cout<<"Susceptible "<<new_s<<" Age Group "<<age_segment_index<<endl;
-                res.susceptible.at(age_segment_index).front() = new_s;
-                travel_international(res,age_segment_index);
+                step.changes.write(res.susceptible.edit().at(age_segment_index).front(), new_s);
+                if (!step.aging)
+                    travel_international(step, res,age_segment_index);
 
             } //for(age_groups)
+        }
 
-            return res;
-        } //local_computation()
+        /**
+         * @brief Computes the next state of every age group, with the exposed, infected and recovered phases of all the
+         * age groups at once (config "cell_kernel": "age_inner", see age_inner_kernel.hpp). The vaccinations are still
+         * computed one age group after the other
+         *
+         * @param step The computation
+         * @param res Next state of the cell
+        */
+        void compute_age_inner(computation& step, sevirds& res) const
+        {
+            // Reused from one call to the next (one set per thread)
+            static thread_local vector<scalar> new_s, new_expos, new_exposD1, new_exposD2, vac_from_rec, vac_from_recD1;
+            static vector<scalar> const none;
+
+            step.fatality_modifier = fatality_modifier(res);
+            new_s.assign(age_segments, 1.0);
+
+            if (is_vaccination)
+            {
+                vector<unique_ptr<AgeData>> datas(3);
+                unsigned int const rec_phases = res.recovered->at(0).size(), rec_phasesD1 = res.recoveredD1->at(0).size();
+                vac_from_rec.assign(rec_phases * age_segments, 0.0);
+                vac_from_recD1.assign(rec_phasesD1 * age_segments, 0.0);
+                new_exposD1.assign(age_segments, 0.0);
+                new_exposD2.assign(age_segments, 0.0);
+
+                for (unsigned int age_segment_index = 0; age_segment_index < age_segments; ++age_segment_index)
+                {
+                    datas.at(NVAC).reset(new AgeData(step.changes, age_segment_index, res.susceptible.edit(), res.exposed.edit(), res.infected.edit(),
+                                                    res.recovered.edit(), memory.config->incubation_rates, memory.config->recovery_rates, memory.config->fatality_rates));
+                    datas.at(VAC1).reset(new AgeData(step.changes, age_segment_index, res.vaccinatedD1.edit(), res.exposedD1.edit(), res.infectedD1.edit(),
+                                                    res.recoveredD1.edit(), memory.config->incubationD1_rates, memory.config->recovery_ratesD1,
+                                                    memory.config->fatality_ratesD1, memory.config->vac1_rates.at(age_segment_index),
+                                                    res.immunityD1_rate->at(age_segment_index), AgeData::PopType::DOSE1));
+                    datas.at(VAC2).reset(new AgeData(step.changes, age_segment_index, res.vaccinatedD2.edit(), res.exposedD2.edit(), res.infectedD2.edit(),
+                                                    res.recoveredD2.edit(), memory.config->incubationD2_rates, memory.config->recovery_ratesD2,
+                                                    memory.config->fatality_ratesD2, memory.config->vac2_rates.at(age_segment_index),
+                                                    res.immunityD2_rate->at(age_segment_index), AgeData::PopType::DOSE2));
+
+                    compute_vaccinated(step, datas, res);
+
+                    // S = 1 - V1 - V2
+                    new_s[age_segment_index] -= datas.at(VAC1)->GetTotalSusceptible();
+                    sanity_check(new_s[age_segment_index], __LINE__);
+                    new_s[age_segment_index] -= datas.at(VAC2)->GetTotalSusceptible();
+
+                    // What the EIRD equations need from the vaccinations, with the age group innermost
+                    for (unsigned int q = 0; q < rec_phases; ++q)
+                        vac_from_rec[q * age_segments + age_segment_index] = datas.at(NVAC)->GetVacFromRec(q);
+                    for (unsigned int q = 0; q < rec_phasesD1; ++q)
+                        vac_from_recD1[q * age_segments + age_segment_index] = datas.at(VAC1)->GetVacFromRec(q);
+
+                    for (unsigned int q = 0; q <= datas.at(VAC1)->GetSusceptiblePhase(); ++q)
+                        new_exposD1[age_segment_index] += datas.at(VAC1)->GetNewExposed(q);
+                    for (unsigned int q = 0; q <= datas.at(VAC2)->GetSusceptiblePhase(); ++q)
+                        new_exposD2[age_segment_index] += datas.at(VAC2)->GetNewExposed(q);
+                }
+            }
+
+            // The exposed, infected and recovered would all stay at 0 in a quiescent cell
+            if (!step.quiescent)
+            {
+                new_expos.assign(age_segments, 0.0);
+                for (unsigned int age_segment_index = 0; age_segment_index < age_segments; ++age_segment_index)
+                {
+                    for (proportion susceptible : res.susceptible->at(age_segment_index))
+                    {
+                        scalar const expos = susceptible * step.infection_pressure[age_segment_index]; // S * sum(1...k)
+                        sanity_check(expos, __LINE__);
+                        new_expos[age_segment_index] += expos;
+                    }
+                }
+
+                age_inner_kernel::advance(memory.config->age_inner.at(NVAC), new_expos, is_vaccination ? vac_from_rec : none, step.fatality_modifier,
+                                            memory.config->reSusceptibility, res.exposed.edit(), res.infected.edit(), res.recovered.edit(),
+                                            new_s, res.fatalities.edit(), step.changes);
+
+                if (is_vaccination)
+                {
+                    age_inner_kernel::advance(memory.config->age_inner.at(VAC1), new_exposD1, vac_from_recD1, step.fatality_modifier,
+                                                memory.config->reSusceptibility, res.exposedD1.edit(), res.infectedD1.edit(), res.recoveredD1.edit(),
+                                                new_s, res.fatalities.edit(), step.changes);
+                    age_inner_kernel::advance(memory.config->age_inner.at(VAC2), new_exposD2, none, step.fatality_modifier,
+                                                memory.config->reSusceptibility, res.exposedD2.edit(), res.infectedD2.edit(), res.recoveredD2.edit(),
+                                                new_s, res.fatalities.edit(), step.changes);
+                }
+            }
+
+            for (unsigned int age_segment_index = 0; age_segment_index < age_segments; ++age_segment_index)
+            {
+                sanity_check(res.fatalities->at(age_segment_index), __LINE__);
+                new_s[age_segment_index] -= res.fatalities->at(age_segment_index);
+                sanity_check(new_s[age_segment_index], __LINE__);
+
+                step.changes.write(res.susceptible.edit().at(age_segment_index).front(), new_s[age_segment_index]);
+                if (!step.aging)
+                    travel_international(step, res, age_segment_index);
+            }
+        }
 
         // It returns the delay to communicate cell's new state.
         // It looks useless but it is extremely important. Do NOT delete!
-        T output_delay(sevirds const& cell_state) const override { return 1; }
+        T output_delay(sevirds const& cell_state) const override { return memory.delay; }
 
         /**
          * @brief Vaccinated Dose 1 - Equation 1a
          * 
+         * @param step The computation
          * @param datas Vector containing the three population types and their data
          * @param res State machine object that holds simulation config data
-         * @return double
+         * @return scalar
          */
-        double new_vaccinated1(vector<unique_ptr<AgeData>>& datas, sevirds const& res) const
+        scalar new_vaccinated1(computation& step, vector<unique_ptr<AgeData>>& datas, sevirds const& res) const
         {
             // Vaccination rate with those who are susceptible
             // vd1 * S
-            double new_vac1 = datas.at(VAC1).get()->GetVaccinationRate(0)  // vd1
-                            * datas.at(NVAC).get()->GetOrigSusceptible(0); // * S
+            scalar new_vac1 = transition(step, datas.at(VAC1).get()->GetVaccinationRate(0)   // vd1
+                                            * datas.at(NVAC).get()->GetOrigSusceptible(0), // * S
+                                         datas.at(NVAC).get()->GetOrigSusceptible(0));
+            step.vaccinated_susceptible = new_vac1;
 
             // And those who are in the recovery phase
-            double sum = 0;
+            scalar sum = 0;
             for (unsigned int q = datas.at(NVAC).get()->GetRecoveredPhase() - 1; q > res.min_interval_recovery_to_vaccine; --q)
             {
                 // Remember these values in the non-vac object as
                 // they are removed from the susceptible group
                 // in increment_recoveries(). Only do math once!!
-                datas.at(NVAC).get()->SetVacFromRec(q - 1,
+                datas.at(NVAC).get()->SetVacFromRec(q - 1, transition(step,
                                                     datas.at(NVAC).get()->GetOrigRecovered(q - 1) // R(q)
-                                                    * datas.at(VAC1).get()->GetVaccinationRate(0) // vd1
+                                                    * datas.at(VAC1).get()->GetVaccinationRate(0), // vd1
+                                                    datas.at(NVAC).get()->GetOrigRecovered(q - 1))
                 );
 
                 sum += datas.at(NVAC).get()->GetVacFromRec(q - 1);
@@ -246,22 +667,23 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
         /**
          * @brief Vaccinated Dose 2 - Equation 2a
          * 
+         * @param step The computation
          * @param datas Vector containing the three population types with their respective data
          * @param res Current state of the cell
-         * @return double
+         * @return scalar
          */
-        double new_vaccinated2(vector<unique_ptr<AgeData>>& datas, sevirds& res, vecDouble const& earlyVac2) const
+        scalar new_vaccinated2(computation& step, vector<unique_ptr<AgeData>>& datas, sevirds& res, vecScalar const& earlyVac2) const
         {
             AgeData& age_data_vac1 = *(datas.at(VAC1)).get();
             AgeData& age_data_vac2 = *(datas.at(VAC2)).get();
 
             // Everybody on the last day of dose 1 is moved to dose 2
-            double vac2 = age_data_vac1.GetOrigSusceptibleBack(); // V1(td1)
+            scalar vac2 = age_data_vac1.GetOrigSusceptibleBack(); // V1(td1)
 
             // Some people are eligible to receive their second dose sooner
             // and this was already computed ealier in compute_vaccinated()
             // qϵ{mtd1...td1 - 1}
-            vac2 += accumulate(earlyVac2.begin(), earlyVac2.end(), 0.0);
+            vac2 += accumulate(earlyVac2.begin(), earlyVac2.end(), scalar{0});
 
             // Some people are eligible to receive their second dose sooner from the dose 1 recovery pop
             // qϵ{mtd1...Tr}
@@ -269,54 +691,102 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
             {
                 // Remember these values for when they are removed from the
                 // vac1 susceptible group in increment_recoveries()
-                age_data_vac1.SetVacFromRec(q - 1,
+                age_data_vac1.SetVacFromRec(q - 1, transition(step,
                                             age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_recovery_to_vaccine) // v(q)
-                                                * age_data_vac1.GetOrigRecovered(q - 1)                                    // RV1(q)
+                                                * age_data_vac1.GetOrigRecovered(q - 1),                                   // RV1(q)
+                                            age_data_vac1.GetOrigRecovered(q - 1))
                 );
 
                 vac2 += age_data_vac1.GetVacFromRec(q - 1);
             }
 
             // - V1(td1) * sum(1...k and 1...Ti))
-            return vac2 - new_exposed(res, *(datas.at(VAC1).get()), age_data_vac1.GetSusceptiblePhase());
+            return vac2 - new_exposed(step, *(datas.at(VAC1).get()), age_data_vac1.GetSusceptiblePhase());
         }
 
         /**
          * @brief Calculates proportion of new exposures from either non-vac or vac (dose 1 or 2) population.
          * 1b, 1c, 1d, 1e, 1f, 2b, 2c, 2d, 2e, 3a, 3b and 3c use this
          * 
-         * @param res State machine object that holds simulation config data
+         * @param step The computation
          * @param age_data Reference to current simulation data
          * @param q Index to compute equation
-         * @return double
+         * @param taken Proportion of the phase that already left it today (see transition())
+         * @return scalar
         */
-        double new_exposed(sevirds& res, AgeData& age_data, int q=0) const
+        scalar new_exposed(computation& step, AgeData& age_data, int q=0, scalar const& taken=0) const
         {
-            double expos = 0, sum = 0, inner_sum, inner_sumV1, inner_sumV2;
+            scalar expos = age_data.GetOrigSusceptible(q) * step.infection_pressure[age_data.GetAge()]; // S * sum(1...k)
+
+            if (age_data.GetType() != AgeData::PopType::NVAC)
+                expos *= 1.0 - age_data.GetImmunityRate( int((q - 1) * 0.14f) ); // 1 - i(q)
+
+            expos = transition(step, expos, age_data.GetOrigSusceptible(q), taken);
+            sanity_check(expos, __LINE__);
+            return expos;
+        } //new_exposed()
+
+        /**
+         * @brief A flow out of a phase: the expected proportion that moves or, with the stochastic transitions, the people
+         * of the phase who move, drawn from a binomial with the expected proportion over the phase as its probability
+         *
+         * When another flow already left the phase, this one is drawn from the people left with its probability scaled up
+         * to match: on average it's still the expected proportion, and the two flows never take more people than the phase has
+         *
+         * @param step The computation
+         * @param expected Proportion that moves on average (ex: ε(q) * E(q))
+         * @param source Proportion in the phase the flow leaves (ex: E(q))
+         * @param taken Proportion already drawn out of the phase by other flows today
+         * @return scalar
+        */
+        scalar transition(computation& step, scalar const& expected, scalar const& source, scalar const& taken=0) const
+        {
+            if (!stochastic)
+                return expected;
+
+            double const left = value_of(source) - value_of(taken);
+            if (left <= 0 || step.people <= 0)
+                return 0;
+
+            return step.draws.binomial(round(left * step.people), value_of(expected) / left) / step.people;
+        }
+
+        /**
+         * @brief The sum over the neighbors used by new_exposed(), for each age group b of the neighbors:
+         * infectious(b) = sum(jϵ{1...k}, cij * kij * Njb / Nj * sum(nϵ{1...Ti}[...])).
+         * It doesn't depend on the equation so it's computed once per day. Also updates the hysteresis of the movement restrictions
+         *
+         * @param step The computation
+         * @param res Next state of the cell
+        */
+        void neighborhood_pressure(computation& step, sevirds const& res) const
+        {
+            Summation::sum<scalar> inner_sum, inner_sumV1, inner_sumV2;
+            fill(step.infectious.begin(), step.infectious.end(), 0.0);
 
             // Calculate the correction factor of the current cell.
             // The current cell must be part of its own neighborhood for this to work!
-            vicinity self_vicinity = state.neighbors_vicinity.at(cell_id);
-            double current_cell_correction_factor = res.disobedient
+            neighbor_view const& self = step.neighbor_views.at(self_edge);
+            scalar current_cell_correction_factor = res.disobedient
                                                     + (1 - res.disobedient)
-                                                    * movement_correction_factor(self_vicinity.correction_factors,
-                                                                                state.neighbors_state.at(cell_id).get_total_infections(),
-                                                                                res.hysteresis_factors.at(cell_id));
+                                                    * movement_correction_factor(self.link->correction_factors,
+                                                                                self.summary->total_infections,
+                                                                                step.next_hysteresis.at(self_edge));
 
-            double neighbor_correction;
+            scalar neighbor_correction;
 
             // jϵ{1...k}
-            for (string neighbor : neighbors)
+            for (unsigned int j = 0; j < neighbors.size(); ++j)
             {
-                sevirds const& nstate = state.neighbors_state.at(neighbor);       // Cell j's state
-                vicinity const& v     = state.neighbors_vicinity.at(neighbor);    // Holds cij and a correction factor used in kij
+                infectious_summary const& nstate = *step.neighbor_views.at(j).summary; // What cell j shares of its state
+                vicinity const& v                = *step.neighbor_views.at(j).link;    // Holds cij and a correction factor used in kij
 
                 // Disobedient people have a correction factor of 1. The rest of the population is affected by the movement_correction_factor
                 neighbor_correction = nstate.disobedient
                                         + (1 - nstate.disobedient)
                                         * movement_correction_factor(v.correction_factors,
-                                                                    nstate.get_total_infections(),
-                                                                    res.hysteresis_factors.at(neighbor));
+                                                                    nstate.total_infections,
+                                                                    step.next_hysteresis.at(j));
 
                 // Logically makes sense to require neighboring cells to follow the movement restriction that is currently
                 // in place in the current cell if the current cell has a more restrictive movement.
@@ -328,105 +798,112 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 // bϵ{1...A}
                 for (unsigned int age_group = 0; age_group < nstate.num_age_groups; ++age_group)
                 {
+                    // Without a contact matrix the sum carries over from one age group to the next, as it always has.
+                    // With one, infectious(b) only holds the infected of age group b
+                    if (!memory.config->contact_matrix.empty())
+                    {
+                        inner_sum = 0; inner_sumV1 = 0; inner_sumV2 = 0;
+                    }
+
+                    proportion const* infected   = nstate.infected(infectious_summary::NVAC, age_group);
+                    proportion const* infectedD1 = nstate.infected(infectious_summary::DOSE1, age_group);
+                    proportion const* infectedD2 = nstate.infected(infectious_summary::DOSE2, age_group);
 
                     // nϵ{1...Ti}
-                    for (unsigned int n = 0; n < nstate.infected.at(age_group).size(); ++n)
+                    for (unsigned int n = 0; n < nstate.num_infected_phases(infectious_summary::NVAC, age_group); ++n)
                     {
                         inner_sum +=
-                            mobility_rates.at(age_group).at(n)    // μ(n)
-                            * virulence_rates.at(age_group).at(n) // λ(n)
-                            * nstate.infected.at(age_group).at(n) // I(n)
+                            memory.config->mobility_rates.at(age_group).at(n)    // μ(n)
+                            * memory.config->virulence_rates.at(age_group).at(n) // λ(n)
+                            * infected[n] // I(n)
                             ;
                     }
 
                     if (is_vaccination)
                     {
                         // nϵ{1...Ti,V1}
-                        for (unsigned int n = 0; n < nstate.infectedD1.at(age_group).size(); ++n)
+                        for (unsigned int n = 0; n < nstate.num_infected_phases(infectious_summary::DOSE1, age_group); ++n)
                         {
                             inner_sumV1 +=
-                                mobility_rates.at(age_group).at(n)      // μ(n)
-                                * virulence_rates.at(age_group).at(n)   // λ(n)
-                                * nstate.infectedD1.at(age_group).at(n) // IV1(n)
+                                memory.config->mobility_rates.at(age_group).at(n)      // μ(n)
+                                * memory.config->virulence_rates.at(age_group).at(n)   // λ(n)
+                                * infectedD1[n] // IV1(n)
                                 ;
                         }
 
                         // nϵ{1...Ti,V2}
-                        for (unsigned int n = 0; n < nstate.infectedD2.at(age_group).size(); ++n)
+                        for (unsigned int n = 0; n < nstate.num_infected_phases(infectious_summary::DOSE2, age_group); ++n)
                         {
                             inner_sumV2 +=
-                                mobility_rates.at(age_group).at(n)      // μ(n)
-                                * virulence_rates.at(age_group).at(n)   // λ(n)
-                                * nstate.infectedD2.at(age_group).at(n) // IV2(n)
+                                memory.config->mobility_rates.at(age_group).at(n)      // μ(n)
+                                * memory.config->virulence_rates.at(age_group).at(n)   // λ(n)
+                                * infectedD2[n] // IV2(n)
                                 ;
                         }
                     }
 
-                    sum += v.correlation                                // cij
-                           * neighbor_correction                        // kij
-                           * (inner_sum + inner_sumV1 + inner_sumV2)    // sum(1...Ti)
-                           * nstate.age_group_proportions.at(age_group) // Njb / Nj
+                    step.infectious.at(age_group) += v.correlation                           // cij
+                                                * neighbor_correction                        // kij
+                                                * (inner_sum + inner_sumV1 + inner_sumV2)    // sum(1...Ti)
+                                                * nstate.age_group_proportions.at(age_group) // Njb / Nj
                         ;
                 }
             }
+        } //neighborhood_pressure()
 
-            expos = age_data.GetOrigSusceptible(q) * sum; // S * sum(1...k)
-
-            if (age_data.GetType() != AgeData::PopType::NVAC)
-                expos *= 1.0 - age_data.GetImmunityRate( int((q - 1) * 0.14f) ); // 1 - i(q)
-
-            sanity_check(expos, __LINE__);
-            return expos;
-        } //new_exposed()
-
-        /**
-         * @brief Exposed: E(q), EV1(q), EV2(q)
-         *  Advance all exposed forward a day, with some proportion leaving exposed(q-1) and entering infected(1)
-         * 
-         * @param age_data Reference to current simulation data for current age group (nvac, dose1, dose2) and age group
-        */
-        void increment_exposed(AgeData& age_data) const
+        // The contact matrix times the infectious vector: an A x A product once per day, shared by every susceptible phase
+        void contact_pressure(computation& step) const
         {
-            double curr_expos;
-
-            // qϵ{2...Te}
-            for (unsigned int q = age_data.GetExposedPhase(); q > 0; --q)
+            for (unsigned int age_group = 0; age_group < age_segments; ++age_group)
             {
-                // Moves each proportion group in the phase to the next day and removes
-                // those who become infected earlier via the incubation rate
-                curr_expos = (1 - age_data.GetIncubationRate(q - 1)) // 1 - ε(q - 1)
-                             * age_data.GetOrigExposed(q - 1)        // * E(q - 1)
-                    ;
-
-                sanity_check(curr_expos, __LINE__);
-                age_data.SetExposed(q, curr_expos);
+                Summation::sum<scalar> sum = 0;
+                if (memory.config->contact_matrix.empty())
+                {
+                    for (scalar const value : step.infectious)
+                        sum += value;
+                }
+                else
+                {
+                    vector<scalar> const& contacts = memory.config->contact_matrix[age_group];
+                    for (unsigned int b = 0; b < step.infectious.size(); ++b)
+                        sum += contacts[b] * step.infectious[b];
+                }
+
+                step.infection_pressure[age_group] = sum;
             }
         }
 
         /**
-         * @brief Infection: I(1), IV1(1), or IV2(1)
-         *  Calculates proportion of new infections from either non-vac or vac (dose 1 or 2) population
-         * 
-         * @param age_data Reference to current simulation data
-         * @return double
+         * @brief Exposed: E(q), EV1(q), EV2(q), and the new infections I(1), IV1(1) or IV2(1), in one pass over the exposed phases.
+         *  Each phase moves forward a day, with some proportion leaving exposed(q - 1) and entering infected(1).
+         *  Everybody on the last day of the exposed phase becomes infected (the incubation rate on Te must be 1)
+         *
+         * @param step The computation
+         * @param age_data Reference to current simulation data for current age group (nvac, dose1, dose2) and age group
+         * @return scalar The new infections
         */
-        double new_infections(AgeData& age_data) const
+        scalar advance_exposed(computation& step, AgeData& age_data) const
         {
-            double inf = 0;
+            scalar inf = 0, curr_expos;
 
-            /* Scan through all exposed days and calculate exposed.at(age).at(q)
-            *   Incubation Rate on Te must be 1.0
-            *   Note: age_data.get()->GetOrigExposed(i) == exposed.at(age).at(q) 
-            *   and at timestep t not t+1
-            *   qϵ{1...Te-1}
-            */
-            for (unsigned int q = 1; q <= age_data.GetExposedPhase(); ++q)
+            // qϵ{1...Te}
+            for (unsigned int q = 0; q <= age_data.GetExposedPhase(); ++q)
             {
-                // Calculates those who move early to the infected phase
-                // and automatically moves those on the last day to the infected phase
-                inf += age_data.GetIncubationRate(q) // ε(q), εV1(q), or εV2(q)
-                       * age_data.GetOrigExposed(q)  // E(q), EV1(q), or EV2(q)
-                    ;
+                scalar const rate  = age_data.GetIncubationRate(q); // ε(q), εV1(q), or εV2(q)
+                scalar const expos = age_data.GetOrigExposed(q);    // E(q), EV1(q), or EV2(q)
+
+                // Those who move early to the infected phase, and those on the last day
+                scalar const moved = transition(step, rate * expos, expos);
+                if (q > 0)
+                    inf += moved;
+
+                // The rest move to the next day
+                if (q < age_data.GetExposedPhase())
+                {
+                    curr_expos = stochastic ? expos - moved : (1 - rate) * expos; // (1 - ε(q)) * E(q)
+                    sanity_check(curr_expos, __LINE__);
+                    age_data.SetExposed(q + 1, curr_expos);
+                }
             }
 
             sanity_check(inf, __LINE__);
@@ -434,77 +911,77 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
         }
 
         /**
-         * @brief Infectd: I(q), IV1(q), IV2(q)
-         *  Advances all infected forward a day, with some already moved to fatalities or recovered prior
-         * 
-         * @param age_data Reference to current simulation data for current age group (nvac, dose1, dose2) and age group
-         * @param recovered Vector of new recoveries from each day
+         * @brief Multiplies the fatality rates of a day: the fatality_modifier of the state if its infections exceed the
+         * hospital capacity at the start of the day, 1 otherwise. Both cell kernels read it once per day
+         *
+         * @param res State of the geographical cell at the start of the day
+         * @return scalar
         */
-        void increment_infections(AgeData& age_data) const
+        scalar fatality_modifier(sevirds const& res) const
         {
-            double curr_inf;
-
-            // qϵ{2...Ti}
-            for (unsigned int q = age_data.GetInfectedPhase(); q > 0; --q)
-            {
-                // The previous day of infections minus those
-                // who have died and those who have recovered
-                curr_inf = age_data.GetOrigInfected(q - 1)    // I(q - 1)
-                           - age_data.GetNewFatalities(q - 1) // - D(q - 1)
-                           - age_data.GetNewRecovered(q - 1)  // - R(q - 1)
-                    ;
-
-                sanity_check(curr_inf, __LINE__);
-                age_data.SetInfected(q, curr_inf);
-            }
+            return res.get_total_infections() > res.hospital_capacity ? res.fatality_modifier : scalar{1.0};
         }
 
         /**
-         * @brief Recovered: R(1), RV1(1), or RV2(1)
-         *  Calculates proportion of new new recoveries from either non-vac or vac (dose 1 or 2) population
-         * 
-         * @param age_data Reference to simulation data for the current age group and population type
-         * @return double
+         * @brief Infected: I(q), IV1(q), IV2(q), with the fatalities and recoveries of each phase, in one pass over the infected phases.
+         *  Of the infected on day q, fa(q) die (more if the hospitals are full), γ(q) recover early and the rest
+         *  move to day q + 1. Anybody who doesn't die on the last day recovers. I(1) is set afterwards from the exposed
+         *
+         * @param step The computation (holds the fatality modifier of the day)
+         * @param age_data Reference to current simulation data for current age group (nvac, dose1, dose2) and age group
+         * @param new_rec Receives the new recoveries R(1), RV1(1) or RV2(1)
+         * @return scalar The new fatalities
         */
-        double new_recoveries(AgeData& age_data) const
+        scalar advance_infected(computation& step, AgeData& age_data, scalar& new_rec) const
         {
-            // Assume that any individuals that are not fatalities on the last stage of infection recover
-            double recoveries = age_data.GetOrigInfectedBack()    // I(q)
-                                - age_data.GetNewFatalitiesBack() // - D(q)
-                ;
+            unsigned int const last = age_data.GetInfectedPhase();
+            scalar const& fatality_modifier = step.fatality_modifier;
 
-            sanity_check(recoveries, __LINE__);
-            age_data.SetNewRecovered(age_data.GetInfectedPhase(), recoveries);
+            // Assume that any individuals that are not fatalities on the last stage of infection recover
+            scalar new_f = 0, fatalities, recoveries, curr_inf;
+            // With the stochastic transitions the fatalities of the last day are drawn below and removed then
+            new_rec = stochastic ? age_data.GetOrigInfected(last)
+                                 : age_data.GetOrigInfected(last) - age_data.GetFatalityRate(last) * age_data.GetOrigInfected(last) * fatality_modifier;
+            sanity_check(new_rec, __LINE__);
 
-            // qϵ{1...Ti - 1}
-            double sum;
-            for (unsigned int q = 0; q <= age_data.GetInfectedPhase() - 1; ++q)
+            // qϵ{1...Ti}
+            for (unsigned int q = 0; q <= last; ++q)
             {
-                // Calculate all of the new recoveries for every day that a population is infected, some recover
-                sum = age_data.GetRecoveryRate(q)   // γ(q)
-                    * age_data.GetOrigInfected(q) // I(q)
-                    ;
+                scalar const inf = age_data.GetOrigInfected(q); // I(q)
 
-                recoveries += sum;
-                age_data.SetNewRecovered(q, sum);
+                fatalities = transition(step, age_data.GetFatalityRate(q) * inf * fatality_modifier, inf); // fa(q) * I(q)
+                new_f     += fatalities;
+
+                if (stochastic && q == last)
+                    new_rec -= fatalities;
+
+                if (q < last)
+                {
+                    recoveries = transition(step, age_data.GetRecoveryRate(q) * inf, inf, fatalities); // γ(q) * I(q), of those who didn't die
+                    new_rec   += recoveries;
+
+                    // The day's infections minus those who have died and those who have recovered
+                    curr_inf = inf - fatalities - recoveries;
+                    sanity_check(curr_inf, __LINE__);
+                    age_data.SetInfected(q + 1, curr_inf);
+                }
             }
 
-            sanity_check(recoveries, __LINE__);
-            return recoveries;
+            sanity_check(new_rec, __LINE__);
+            sanity_check(new_f, __LINE__);
+            return new_f;
         }
 
         /**
-         * @brief Infectd: R(q), RV1(q), RV2(q)
-         *  Advances all infected forward a day, with some already moved to fatalities or recovered prior
+         * @brief Recovered: R(q), RV1(q), RV2(q)
+         *  Advances all recovered forward a day, minus those who got vaccinated (see new_vaccinated1() and new_vaccinated2())
          * 
          * @param age_data Reference to current simulation data for current age group (nvac, dose1, dose2) and age group
-         * @param recovered_index If res-susc is turned on this will avoid processing the population on the last day
-         * @param age_data_vac Pointer to a vaccinated age_data object that is used for R(q) and RV1(q)
-         * @param res Used to get the minimum interval between doses needed in RV1(q)
+         * @param new_rec New recoveries, who start on the first day
         */
-        void increment_recoveries(AgeData& age_data) const
+        void advance_recovered(AgeData& age_data, scalar new_rec) const
         {
-            double curr_rec;
+            scalar curr_rec;
 
             // qϵ{2...Tr}
             for (unsigned int q = age_data.GetRecoveredPhase(); q > 0; --q)
@@ -512,7 +989,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 curr_rec = 0;
 
                 // When resusceptibility is off then those who are recovered stay in that phase
-                if (!reSusceptibility && q == age_data.GetRecoveredPhase())
+                if (!memory.config->reSusceptibility && q == age_data.GetRecoveredPhase())
                     curr_rec += age_data.GetRecoveredBack();
 
                 // Each day of the recovered phase is the value of the previous day. The population on the last day is
@@ -524,112 +1001,194 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 sanity_check(curr_rec, __LINE__);
                 age_data.SetRecovered(q, curr_rec);
             }
+
+            // The people on the first day of recovery are those that were on the last stage of infection (minus those who died;
+            // already accounted for) in the previous time step plus those that recovered early during an infection stage.
+            age_data.SetRecovered(0, new_rec);
+        }
+
+        /**
+         * @brief Moves on to another config of the same model, which only differs by its rates and restrictions
+         * (see timeline.hpp)
+         *
+         * @param next The config
+        */
+        void take_config(shared_ptr<config_type const> next) const
+        {
+            memory.config = move(next);
         }
 
         /**
-         * @brief New fatalities for one population group (Non-Vaccinated/Vaccinated Dose 1/Vaccinvated Dose 2)
-         *  These are calculated individually as the vector of new fatalities is used by the functions
-         *  that follow this one (see compute_vaccinated() and compute_not_vaccinated()). If we calculated
-         *  the global number of fatalities later when we do something like dose1.infected().at(q) - fatalities.at(q)
-         *  to get the maximum number of possible recoveries the fatality number will be including those from dose 2 and
-         *  not vaccinated when in reality the maximum number of recoveries for dose1 is limited to those who are infected
-         *  with dose 1 and still alive so we only want to remove those who are dose 1 fatality.
+         * @brief Gives new modifiers to the state the cell computes next, as a state change of a timeline would
+         * (see geographical_coupled::modify())
          *
-         * @param res State of the geographical cell (holds some global data)
-         * @param age_data Contains the data of the proportion. In this function the infections proportion as well as
-         *                  the fatality rates are used from here
-         * @return double
+         * @param modifiers Any of "disobedient", "hospital_capacity" or "fatality_modifier"
         */
-        double new_fatalities(sevirds const& res, AgeData& age_data) const
+        void modify_state(nlohmann::json const& modifiers)
         {
-            double new_f = 0.0, sum;
+            memory.queued_modifiers.push_back(modifiers);
+        }
 
-            // Calculate all those who have died during an infection stage.
-            // qϵ{1...Ti}
-            for (unsigned int q = 0; q <= age_data.GetInfectedPhase(); ++q)
+        /**
+         * @brief Moves on to the config of the stage of the timeline the day is in and gathers the state changes
+         * of the day for this cell, if the config has a timeline (see timeline.hpp)
+        */
+        void follow_timeline(computation& step) const
+        {
+            step.due_changes.clear();
+            step.new_stage = false;
+            if (!events)
+                return;
+
+            vector<timeline::stage> const& stages = events->get_stages();
+            for (; memory.next_stage < stages.size() && stages[memory.next_stage].day <= simulation_clock; ++memory.next_stage)
             {
-                // fa(q) * I(q)
-                sum = age_data.GetFatalityRate(q) * age_data.GetOrigInfected(q);
+                take_config(stages[memory.next_stage].config);
+                step.new_stage = true;
+            }
 
-                // Amplify fatality rate if the hospitals are full
-                if (res.get_total_infections() > res.hospital_capacity)
-                    sum *= res.fatality_modifier;
+            vector<timeline::state_change> const& changes = events->get_changes();
+            for (; memory.next_change < changes.size() && changes[memory.next_change].day <= simulation_clock; ++memory.next_change)
+            {
+                if (changes[memory.next_change].applies_to(cell_id))
+                    step.due_changes.push_back(&changes[memory.next_change]);
+            }
+        }
 
-                new_f += sum;
-                age_data.SetNewFatalities(q, sum);
+        // Whether the day has state changes for the cell, which go out with its state even if nothing else changed
+        bool in_timeline(computation const& step) const
+        {
+            return !step.due_changes.empty() || !memory.queued_modifiers.empty();
+        }
+
+        /**
+         * @brief Sends the state of a settled cell again, for it to compute on the day of its next event: the next stage
+         * of the timeline or the next state change for this cell. Without it the cell would wait for a neighbor to change
+         *
+         * @param res Next state of the cell, the current one
+        */
+        void wake_up(sevirds& res) const
+        {
+            double day = numeric_limits<double>::infinity();
+            vector<timeline::stage> const& stages = events->get_stages();
+            if (memory.next_stage < stages.size())
+                day = stages[memory.next_stage].day;
+
+            vector<timeline::state_change> const& changes = events->get_changes();
+            for (unsigned int k = memory.next_change; k < changes.size() && changes[k].day < day; ++k)
+            {
+                if (changes[k].applies_to(cell_id))
+                    day = changes[k].day;
             }
 
-            sanity_check(new_f, __LINE__);
-            return new_f;
+            // Only once per event, the state sent the first time is still on its way unless a newer one replaced it (see next_state())
+            if (isinf(day) || day == memory.wake_day)
+                return;
+
+            memory.wake_day = day;
+            memory.delay    = day - simulation_clock;
+            ++res.version;
+        }
+
+        /**
+         * @brief Whether the cell has nobody exposed, infected or recovered and none of its
+         * neighbors (itself included) are infectious. Travel can still bring in exposed people
+         * (see travel_international()), in which case the cell wakes up the next day
+         *
+         * @param step The computation
+         * @return bool
+        */
+        bool is_quiescent(computation const& step, sevirds const& current) const
+        {
+            if (!current.is_infection_free())
+                return false;
+
+            for (neighbor_view const& neighbor : step.neighbor_views)
+            {
+                if (!neighbor.summary->not_infectious)
+                    return false;
+            }
+
+            return true;
+        }
+
+        // Fills neighbor_views with the latest states received from the neighbors
+        void gather_neighbors(computation& step) const
+        {
+            step.neighbor_views.resize(neighbors.size());
+            if (events)
+                memory.received.resize(neighbors.size(), {0, nullptr});
+
+            for (unsigned int j = 0; j < neighbors.size(); ++j)
+            {
+                // A state sent by wake_up() arrives after the ones the neighbor sent since
+                sevirds const& neighbor = state.neighbors_state.at(neighbors.at(j));
+                if (events && (!memory.received[j].summary || neighbor.version >= memory.received[j].version))
+                    memory.received[j] = {neighbor.version, neighbor.summary};
+
+                step.neighbor_views.at(j).summary = summary_of(j).get();
+                step.neighbor_views.at(j).link    = &state.neighbors_vicinity.at(neighbors.at(j));
+            }
         }
 
-        double movement_correction_factor(const map<infection_threshold, mobility_correction_factor>& mobility_correction_factors,
-                                        double infectious_population, hysteresis_factor& hysteresisFactor) const
+        // Summary of the newest state received from the neighbor j
+        shared_ptr<infectious_summary const> const& summary_of(unsigned int j) const
         {
-            // For example, assume a correction factor of "0.4": [0.2, 0.1]. If the infection goes above 0.4, then the
-            // correction factor of 0.2 will now be applied to total infection values above 0.3, no longer 0.4 as the
-            // hysteresis is in effect.
-            if (infectious_population > hysteresisFactor.infections_higher_bound)
-                hysteresisFactor.in_effect = false;
+            return events ? memory.received[j].summary : state.neighbors_state.at(neighbors.at(j)).summary;
+        }
 
-            // This is uses the comparison '>', not '>=' ; otherwise if the lower bound is 0 there is no way for the hysteresis
-            // to disappear as the infections can never go below 0
-            if (hysteresisFactor.in_effect && infectious_population > hysteresisFactor.infections_lower_bound)
-                return hysteresisFactor.mobility_correction_factor;
+        /**
+         * @brief Whether the next state would only be the current one again: the last computation left the state as it was,
+         * and the neighbors still show the summaries it read. With a state_change_tolerance the neighbors send many states
+         * whose summary they kept (see next_state()), which then don't cost a computation. Records the summaries read
+         *
+         * @param step The computation
+         * @return bool
+        */
+        bool repeats_itself(computation const& step) const
+        {
+            if (memory.config->state_change_tolerance <= 0)
+                return false;
 
-            hysteresisFactor.in_effect = false;
+            bool same = memory.settled && !memory.drew_travelers && memory.read_summaries.size() == neighbors.size();
+            memory.read_summaries.resize(neighbors.size());
 
-            double correction = 1.0;
-            for (auto const& pair: mobility_correction_factors)
+            for (unsigned int j = 0; j < neighbors.size(); ++j)
             {
-                if (infectious_population >= pair.first)
+                // The summaries are kept alive here, so a new one can't be at the address of an old one
+                shared_ptr<infectious_summary const> const& summary = summary_of(j);
+                if (memory.read_summaries[j] != summary)
                 {
-                    correction = pair.second.front();
-
-                    // A hysteresis factor will be in effect until the total infection goes below the hysteresis factor;
-                    // until that happens the information required to return a movement factor must be kept in above variables.
-
-                    // Get the threshold of the next correction factor; otherwise the current correction factor can remain in
-                    // effect if the total infections never goes below the lower bound hysteresis factor, but also if it goes
-                    // above the original total infection threshold!
-                    auto next_pair_iterator = find(mobility_correction_factors.begin(), mobility_correction_factors.end(), pair);
-                    AssertLong(next_pair_iterator != mobility_correction_factors.end(), __FILE__, __LINE__);
-
-                    // If there is a next correction factor (for a higher total infection), then use it's total infection threshold
-                    if ((long unsigned int) distance(mobility_correction_factors.begin(), next_pair_iterator) != mobility_correction_factors.size() - 1)
-                        ++next_pair_iterator;
-
-                    hysteresisFactor.in_effect                  = true;
-                    hysteresisFactor.infections_higher_bound    = next_pair_iterator->first;
-                    hysteresisFactor.infections_lower_bound     = pair.first - pair.second.back();
-                    hysteresisFactor.mobility_correction_factor = pair.second.front();
-                } else
-                    break;
+                    memory.read_summaries[j] = summary;
+                    same = false;
+                }
             }
 
-            return correction;
-        } //movement_correction_factor()
+            // Stochastic transitions, the infection pressures of the engine and timelines change the state on their own
+            return same && !stochastic && !engine && !in_timeline(step) && !step.new_stage;
+        }
 
         /**
          * @brief Computes all the equations specific to the vaccinated population
          * 
+         * @param step The computation
          * @param datas Vector of AgeData objects containing current age group data
          * @param res The current state of the geographical cell
         */
-        void compute_vaccinated(vector<unique_ptr<AgeData>>& datas, sevirds& res) const
+        void compute_vaccinated(computation& step, vector<unique_ptr<AgeData>>& datas, sevirds& res) const
         {
-            double curr_vac1 = 0.0, curr_vac2 = 0.0;
+            scalar curr_vac1 = 0.0, curr_vac2 = 0.0;
 
             AgeData& age_data_vac1 = *(datas.at(VAC1).get());
             AgeData& age_data_vac2 = *(datas.at(VAC2).get());
 
             // Holds those who get their second dose earlier from the susceptible dose 1 group
             // This is not the same as vacFromRec in AgeData.hpp
-            vecDouble earlyVac2(age_data_vac1.GetSusceptiblePhase(), 0.0);
+            vecScalar earlyVac2(age_data_vac1.GetSusceptiblePhase(), 0.0);
 
             // <VACCINATED DOSE 1>
                 // Calculate the number of new vaccinated dose 1
-                double new_vac1 = new_vaccinated1(datas, res); // 1a
+                scalar new_vac1 = new_vaccinated1(step, datas, res); // 1a
 
                 // qϵ{2...td1}
                 for (unsigned int q = age_data_vac1.GetSusceptiblePhase(); q > 0; --q)
@@ -637,7 +1196,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                     // 1b & 1d
                     curr_vac1 = age_data_vac1.GetOrigSusceptible(q - 1); // V1(q - 1)
 
-                    age_data_vac1.SetNewExposed(q, new_exposed(res, age_data_vac1, q - 1));
+                    age_data_vac1.SetNewExposed(q, new_exposed(step, age_data_vac1, q - 1));
                     curr_vac1 -= age_data_vac1.GetNewExposed(q); // - ( V1(q - 1) * (1 - iv1(q - 1)) * sum(1..k and 1...Ti) )
 
                     // Early dose 2
@@ -645,13 +1204,15 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                     {
                         // 1d
                         if (q > res.min_interval_recovery_to_vaccine)
-                            earlyVac2.at(q - 1) = age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_recovery_to_vaccine) // vd2(q - 1)
-                                                * age_data_vac1.GetOrigSusceptible(q - 1)                                        // * V1(q - 1)
+                            earlyVac2.at(q - 1) = transition(step, age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_recovery_to_vaccine) // vd2(q - 1)
+                                                    * age_data_vac1.GetOrigSusceptible(q - 1),                                      // * V1(q - 1)
+                                                age_data_vac1.GetOrigSusceptible(q - 1), age_data_vac1.GetNewExposed(q))
                             ;
                         // 1c substracts early dose2 vaccinations from 1b
                         else
-                            earlyVac2.at(q - 1) = age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_doses) // vd2(q - 1)
-                                                * age_data_vac1.GetOrigSusceptible(q - 1)                          // * V1(q - 1)
+                            earlyVac2.at(q - 1) = transition(step, age_data_vac2.GetVaccinationRate(q - 1 - res.min_interval_doses) // vd2(q - 1)
+                                                    * age_data_vac1.GetOrigSusceptible(q - 1),                        // * V1(q - 1)
+                                                age_data_vac1.GetOrigSusceptible(q - 1), age_data_vac1.GetNewExposed(q))
                             ;
 
                         curr_vac1 -= earlyVac2.at(q - 1);
@@ -664,9 +1225,9 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 }
 
                 // 1d
-                if (reSusceptibility)
+                if (memory.config->reSusceptibility)
                 {
-                    double susc_from_rec = age_data_vac1.GetOrigRecoveredBack()                                                                             // RV1(Tr)
+                    scalar susc_from_rec = age_data_vac1.GetOrigRecoveredBack()                                                                             // RV1(Tr)
                                         * (1 - age_data_vac2.GetVaccinationRate(age_data_vac1.GetRecoveredPhase() - res.min_interval_recovery_to_vaccine)); // * (1 - vd2(Tr))
                     age_data_vac1.AddSusceptibleBack(susc_from_rec);
                 }
@@ -678,7 +1239,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
 
             // <VACCINATED DOSE 2>
                 // Calculate the number of new vaccinated dose 2
-                double new_vac2 = new_vaccinated2(datas, res, earlyVac2);
+                scalar new_vac2 = new_vaccinated2(step, datas, res, earlyVac2);
                 sanity_check(new_vac2, __LINE__);
 
                 // qϵ{2...td2 - 1}
@@ -687,7 +1248,7 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                     // 2b
                     curr_vac2 = age_data_vac2.GetOrigSusceptible(q - 1); // V2(q - 1)
 
-                    age_data_vac2.SetNewExposed(q, new_exposed(res, age_data_vac2, q - 1));
+                    age_data_vac2.SetNewExposed(q, new_exposed(step, age_data_vac2, q - 1));
                     curr_vac2 -= age_data_vac2.GetNewExposed(q); // - V2(q - 1) * (1 - iv2(q - 1)) * sum( jϵ{1…k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...])) )
 
                     sanity_check(curr_vac2, __LINE__);
@@ -695,15 +1256,15 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                 }
 
                 // 2c
-                double end = age_data_vac2.GetOrigSusceptible(age_data_vac2.GetSusceptiblePhase() - 1) // V2(td2 - 1)
+                scalar end = age_data_vac2.GetOrigSusceptible(age_data_vac2.GetSusceptiblePhase() - 1) // V2(td2 - 1)
                       + age_data_vac2.GetOrigSusceptibleBack();                                        // V2(td2)
 
-                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase() - 1, new_exposed(res, age_data_vac2, age_data_vac2.GetSusceptiblePhase() - 1));
-                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase(), new_exposed(res, age_data_vac2, age_data_vac2.GetSusceptiblePhase()));
+                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase() - 1, new_exposed(step, age_data_vac2, age_data_vac2.GetSusceptiblePhase() - 1));
+                age_data_vac2.SetNewExposed(age_data_vac2.GetSusceptiblePhase(), new_exposed(step, age_data_vac2, age_data_vac2.GetSusceptiblePhase()));
                 end -= age_data_vac2.GetNewExposed(age_data_vac2.GetSusceptiblePhase() - 1); // - V2(td2 - 1) * (1 - iV2(td2 - 1)) * sum( jϵ{1...k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...]) )
                 end -= age_data_vac2.GetNewExposed(age_data_vac2.GetSusceptiblePhase());     // - V2(td2) * (1 - iV2(td2)) * sum( jϵ{1...k}(cij * kij * sum(bϵ{1...A} and nϵ{1...Ti}[...]) )
 
-                if (reSusceptibility)
+                if (memory.config->reSusceptibility)
                     end += age_data_vac2.GetOrigRecoveredBack(); // + RV2(Tr)
 
                 sanity_check(end, __LINE__);
@@ -717,28 +1278,17 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          * @brief Computes the exposed, infected, recovered, and dead equations for all population types
          * Setup the the datas vector to hold all the population types and they'll be looped through
          * 
+         * @param step The computation
          * @param datas Vector of pointers holding the population states (i.e., NVac, Dose1, Dose2)
-         * @param res Current cell data
          */
-        void compute_EIRD(vector<unique_ptr<AgeData>>& datas, sevirds& res) const
+        void compute_EIRD(computation& step, vector<unique_ptr<AgeData>>& datas) const
         {
 //            AssertLong(0==0,__FILE__,__LINE__,"Here Travelled");
-            double new_expos, new_inf, new_rec;
+            scalar new_expos, new_inf, new_rec;
 
             for (unique_ptr<AgeData>& age_data_ptr : datas)
             {
                 AgeData& age_data = *(age_data_ptr.get());
-                // <FATALITIES>
-                    // Calculates the new fatalities on each day of the infected phase
-                    // for easy use and less repetive code later
-                    age_data.SetTotalFatalities(new_fatalities(res, age_data));
-                    sanity_check(age_data.GetTotalFatalities(), __LINE__);
-                // </FATALITIES>
-
-                // <RECOVERIES>
-                    // Calculates the new recoveries on each day of the infected phase
-                    new_rec = new_recoveries(age_data);
-                // </RECOVERIES>
 
                 // <EXPOSED>
                     new_expos = 0.0;
@@ -749,30 +1299,21 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
                         if (age_data.GetType() != AgeData::PopType::NVAC)
                             new_expos += age_data.GetNewExposed(q);
                         else
-                            new_expos += new_exposed(res, age_data, q);
+                            new_expos += new_exposed(step, age_data, q, q == 0 ? step.vaccinated_susceptible : scalar{0});
                     }
 
-                    increment_exposed(age_data);
-
-//                    travel_international(res,new_expos);
-
+                    new_inf = advance_exposed(step, age_data);
                     age_data.SetExposed(0, new_expos);
                 // </EXPOSED>
 
                 // <INFECTED>
-                    new_inf = new_infections(age_data);
-
-                    increment_infections(age_data);
-
+                    // Fatalities, recoveries and the infected phases at once
+                    age_data.SetTotalFatalities(advance_infected(step, age_data, new_rec));
                     age_data.SetInfected(0, new_inf);
                 // </INFECTED>
 
                 // <RECOVERED>
-                    increment_recoveries(age_data);
-
-                    // The people on the first day of recovery are those that were on the last stage of infection (minus those who died;
-                    // already accounted for) in the previous time step plus those that recovered early during an infection stage.
-                    age_data.SetRecovered(0, new_rec);
+                    advance_recovered(age_data, new_rec);
                 // </RECOVERED>
             }
         }
@@ -780,57 +1321,64 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
         /**
          * @brief Computes updated total population after some population travel to neighbours
          *
+         * @param step The computation
          * @param res Current cell data
          */
-         void travel_international(sevirds& res, unsigned int age_segment_index) const {
+         void travel_international(computation& step, sevirds& res, unsigned int age_segment_index) const {
 //             res.population = res.population - 10000;
 //            AssertLong(0==0,__FILE__,__LINE__,"Here Travelled");
-            if(travel_restriction=="total")
+            if(memory.config->travel==travel_policy::total)
                 return;
             else{
-                for (string neighbor : neighbors) {
-                    sevirds const& nstate = state.neighbors_state.at(neighbor);
-                    vicinity const& v     = state.neighbors_vicinity.at(neighbor);
+                sevirds::proportionVector& susceptible = res.susceptible.edit();
+                sevirds::proportionVector& exposed     = res.exposed.edit();
+
+                for (neighbor_view const& neighbor : step.neighbor_views) {
+                    infectious_summary const& nstate = *neighbor.summary;
+                    vicinity const& v                = *neighbor.link;
 
-                    if(travel_restriction=="none"){
+                    if(memory.config->travel==travel_policy::none){
+                        memory.drew_travelers = true;
                         double orig_population = res.population;
-                        double random_factor = ((double)rand()/(double)RAND_MAX)/1e2;
+                        double random_factor = Random::uniform()/1e2;
                         double out_factor = random_factor*v.correlation;
                         double travellers_leaving = res.population*out_factor;
                         res.population -= travellers_leaving;
-                        random_factor = ((double)rand()/(double)RAND_MAX)/1e2;
+                        random_factor = Random::uniform()/1e2;
                         double in_factor = random_factor*v.correlation;
                         double travelers_coming = res.population*in_factor;
                         res.population += travelers_coming;
-                        double exposed_pop = res.exposed.at(age_segment_index).front()*orig_population + travelers_coming;
-                        double new_exposed_pop = exposed_pop/res.population;
-                        if(res.susceptible.at(age_segment_index).front()-new_exposed_pop-res.exposed.at(age_segment_index).front()>0) {
-                            res.susceptible.at(age_segment_index).front() -= (new_exposed_pop - res.exposed.at(
-                                    age_segment_index).front());
-                            res.exposed.at(age_segment_index).front() = new_exposed_pop;
+                        scalar exposed_pop = exposed.at(age_segment_index).front()*orig_population + travelers_coming;
+                        scalar new_exposed_pop = exposed_pop/res.population;
+                        if(susceptible.at(age_segment_index).front()-new_exposed_pop-exposed.at(age_segment_index).front()>0) {
+                            proportion& s = susceptible.at(age_segment_index).front();
+                            step.changes.write(s, s - (new_exposed_pop - exposed.at(age_segment_index).front()));
+                            step.changes.write(exposed.at(age_segment_index).front(), new_exposed_pop);
                         }
                     }
-                    else if(travel_restriction=="partial"
-                    && (nstate.get_total_vaccinatedD2(age_segment_index)>0.75 || nstate.get_total_recovered(age_segment_index)>0.75)
-                    && nstate.get_total_infections(age_segment_index)<0.2){
+                    else if(memory.config->travel==travel_policy::partial
+                    && (nstate.vaccinatedD2.at(age_segment_index)>0.75 || nstate.recovered.at(age_segment_index)>0.75)
+                    && nstate.infections.at(age_segment_index)<0.2){
+                        memory.drew_travelers = true;
                         double orig_population = res.population;
-                        double random_factor = ((double)rand()/(double)RAND_MAX)/1e2;
+                        double random_factor = Random::uniform()/1e2;
                         double out_factor = random_factor*v.correlation;
                         double travellers_leaving = res.population*out_factor;
                         res.population -= travellers_leaving;
-                        random_factor = ((double)rand()/(double)RAND_MAX)/1e2;
+                        random_factor = Random::uniform()/1e2;
                         double in_factor = random_factor*v.correlation;
                         double travelers_coming = res.population*in_factor;
                         res.population += travelers_coming;
-                        double exposed_pop = res.exposed.at(age_segment_index).front()*orig_population + travelers_coming;
-                        double new_exposed_pop = exposed_pop/res.population;
-                        if(res.susceptible.at(age_segment_index).front()-new_exposed_pop-res.exposed.at(age_segment_index).front()>0) {
-                            res.susceptible.at(age_segment_index).front() -= (new_exposed_pop - res.exposed.at(
-                                    age_segment_index).front());
-                            res.exposed.at(age_segment_index).front() = new_exposed_pop;
+                        scalar exposed_pop = exposed.at(age_segment_index).front()*orig_population + travelers_coming;
+                        scalar new_exposed_pop = exposed_pop/res.population;
+                        if(susceptible.at(age_segment_index).front()-new_exposed_pop-exposed.at(age_segment_index).front()>0) {
+                            proportion& s = susceptible.at(age_segment_index).front();
+                            step.changes.write(s, s - (new_exposed_pop - exposed.at(age_segment_index).front()));
+                            step.changes.write(exposed.at(age_segment_index).front(), new_exposed_pop);
                         }
                         if(out_factor>in_factor){
-                            res.susceptible.at(age_segment_index).front() += (out_factor-in_factor);
+                            proportion& s = susceptible.at(age_segment_index).front();
+                            step.changes.write(s, s + (out_factor-in_factor));
                         }
                     }
                 }
@@ -840,12 +1388,13 @@ class geographical_cell : public cell<T, string, sevirds, vicinity>
          * @brief Basic check that the proportion is not
          * less then 0 or bigger then 1
          * 
-         * @param value Proportion to check
+         * @param checked Proportion to check
          * @param line  Line the function is called from (use __LINE__)
          */
-        void sanity_check(double value, unsigned int line) const
+        void sanity_check(scalar const& checked, unsigned int line) const
         {
             sevirds const& res = state.current_state;
+            double value = value_of(checked);
 
             // Can't be bigger then 1 or less then 0
             if (value < (0 - res.one_over_prec_divider) || value > (1 + res.one_over_prec_divider))
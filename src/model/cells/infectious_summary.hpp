@@ -0,0 +1,50 @@
+#ifndef PANDEMIC_HOYA_2002_INFECTIOUS_SUMMARY_HPP
+#define PANDEMIC_HOYA_2002_INFECTIOUS_SUMMARY_HPP
+
+#include <vector>
+#include "../Helpers/Dual.hpp"
+
+using namespace std;
+
+/**
+ * The part of a cell's state that its neighbors read: the infected phases and the totals
+ * used by the movement restrictions and by travel. It's built once per cell per day
+ * (see sevirds::summarize()) and shared by every copy of that state, so the neighbors
+ * don't go through the whole state or recompute the totals every time they need them.
+*/
+template <typename P>
+struct infectious_summary_t
+{
+    // Population types, in the order their infected phases are stored
+    enum PopType { NVAC = 0, DOSE1 = 1, DOSE2 = 2, POP_TYPES = 3 };
+
+    unsigned int num_age_groups = 0;
+    vector<double> age_group_proportions;
+    scalar disobedient = 0;
+
+    // Same as sevirds::get_total_infections()
+    double total_infections = 0;
+
+    // Nobody in any of the infected phases (see sevirds::is_not_infectious())
+    bool not_infectious = true;
+
+    // Per age group. Same as sevirds::get_total_infections(age), get_total_vaccinatedD2(age) and get_total_recovered(age)
+    vector<double> infections;
+    vector<double> vaccinatedD2;
+    vector<double> recovered;
+
+    // The infected phases of every population type and age group one after the other.
+    // Those of pop_type and age start at phase_begin[pop_type * num_age_groups + age]
+    vector<P> infected_phases;
+    vector<unsigned int> phase_begin;
+
+    P const* infected(PopType pop_type, unsigned int age) const { return infected_phases.data() + phase_begin[pop_type * num_age_groups + age]; }
+
+    unsigned int num_infected_phases(PopType pop_type, unsigned int age) const
+    {
+        unsigned int const i = pop_type * num_age_groups + age;
+        return phase_begin[i + 1] - phase_begin[i];
+    }
+};
+
+#endif //PANDEMIC_HOYA_2002_INFECTIOUS_SUMMARY_HPP
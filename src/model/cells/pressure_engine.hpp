@@ -0,0 +1,436 @@
+#ifndef PANDEMIC_HOYA_2002_PRESSURE_ENGINE_HPP
+#define PANDEMIC_HOYA_2002_PRESSURE_ENGINE_HPP
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "infectious_summary.hpp"
+#include "simulation_config.hpp"
+#include "travel_network.hpp"
+#include "far_field.hpp"
+#include "timeline.hpp"
+#include "vicinity.hpp"
+#include "hysteresis_factor.hpp"
+#include "sevirds.hpp"
+#include "../Helpers/Assert.hpp"
+#include "../Helpers/Ordering.hpp"
+#include "../Helpers/Summation.hpp"
+
+using namespace std;
+
+/**
+ * Computes the infection pressure of every cell of a model at once (config "infection_pressure": "spmv").
+ *
+ * The sum over the neighbors in geographical_cell::neighborhood_pressure() is the product of a sparse matrix,
+ * A(i, j) = cij * kij over the neighborhoods, with the vectors x(j, b) = Njb / Nj * sum(b' <= b, n, μ(n) * λ(n) * Ijb'(n))
+ * of each cell's infectious load by age group (only b' = b with a contact_matrix). Each day the matrix is assembled again in CSR form (kij depends
+ * on the infections and on the hysteresis) and multiplied in one pass, the first time a cell asks for its pressure.
+ * Every entry of the matrix multiplies the loads of all the age groups of its column at once.
+ *
+ * Every cell publishes its states here as it sends them to its neighbors, so the engine holds
+ * the same states as the neighbors_state of the cells.
+ *
+ * The engine also carries the long-range travel of the config's "travel_network" (see travel_network.hpp),
+ * whatever the infection_pressure. Those flows add T(i, j) * x(j, b) to the pressure of their destination,
+ * with T(i, j) the correlation of the flow from j to i, as long as the travel_restriction lets people
+ * leave j. Since the engine reads the states of every cell, the origins don't have to be neighbors.
+ * With the config's "far_field" that sum is approximated by clusters of cells (see far_field.hpp).
+ *
+ * Before the first day the rows are renumbered in reverse Cuthill-McKee order of the neighborhoods, so the loads a
+ * row reads are mostly next to each other instead of scattered in the order of the scenario. The cells keep the
+ * row add_cell() gave them, which the engine maps to its own.
+*/
+template <typename T>
+class pressure_engine
+{
+    public:
+        explicit pressure_engine(shared_ptr<simulation_config const> shared_config) :
+            config{move(shared_config)},
+            num_age_groups{static_cast<unsigned int>(config->virulence_rates.size())},
+            border_pressure{config->infection_pressure == "spmv"}
+        {
+            if (!config->travel_network.empty())
+                travel = travel_network(config->travel_network);
+            if (!config->far_field_clusters.empty())
+                clusters = far_field(config->far_field_clusters);
+        }
+
+        // Makes the engine move on to the config of each stage of a timeline on its day, as the cells do
+        void follow(shared_ptr<timeline const> cell_timeline) { events = move(cell_timeline); }
+
+        // Moves on to another config of the same model, as the cells do (see geographical_cell::take_config())
+        void take_config(shared_ptr<simulation_config const> next) { config = move(next); }
+
+        shared_ptr<simulation_config const> const& get_config() const { return config; }
+
+        // Whether there are flows between cells outside of the neighborhoods
+        bool has_travel() const { return !travel.empty(); }
+
+        /**
+         * @brief Adds a cell, which becomes a row of the matrix
+         *
+         * @param cell_id Id of the cell
+         * @param neighbors Neighbors of the cell (including itself), in the order of its neighbors vector
+         * @param neighborhood Vicinity of each neighbor
+         * @param shared_config Config of the cell, which must be the one of the engine
+         * @return unsigned int Row of the cell
+        */
+        unsigned int add_cell(string const& cell_id, vector<string> const& neighbors, unordered_map<string, vicinity> const& neighborhood,
+                                shared_ptr<simulation_config const> const& shared_config)
+        {
+            AssertLong(shared_config == config, __FILE__, __LINE__,
+                        "All the cells must have the same config to compute the infection pressure with \"spmv\" (" + cell_id + " doesn't)");
+            AssertLong(!assembled, __FILE__, __LINE__, "Cells can't be added once the simulation started");
+
+            unsigned int const row = ids.size();
+            row_ids.insert({cell_id, row});
+            ids.push_back(cell_id);
+            position.push_back(row);
+
+            for (string const& neighbor : neighbors)
+            {
+                edge_ids.push_back(neighbor);
+                edges.push_back(neighborhood.at(neighbor));
+                if (neighbor == cell_id)
+                    self_edges.push_back(edges.size() - 1);
+            }
+            row_begin.push_back(edges.size());
+
+            AssertLong(self_edges.size() == ids.size(), __FILE__, __LINE__, "The cell " + cell_id + " must be part of its own neighborhood");
+
+            published.emplace_back();
+            pending.emplace_back();
+            return row;
+        }
+
+        /**
+         * @brief Records a state sent by a cell to its neighbors
+         *
+         * @param row Row of the cell
+         * @param summary Summary of the state
+         * @param time Time the neighbors receive it
+        */
+        void publish(unsigned int row, shared_ptr<infectious_summary const> summary, T time)
+        {
+            // A state computed today only reaches the neighbors later, so it waits until then
+            pending.at(position[row]) = {time, move(summary)};
+        }
+
+        /**
+         * @brief Infection pressure of a cell: sum(j, cij * kij * x(j, b)) for each age group b.
+         * Computed for every cell the first time it's asked on a day
+         *
+         * @param row Row of the cell
+         * @param time Current time
+         * @return double const* One value per age group of the config
+        */
+        double const* pressure(unsigned int row, T time)
+        {
+            if (!computed || time != computed_time)
+                compute(time);
+
+            return pressures.data() + position[row] * num_age_groups;
+        }
+
+        /**
+         * @brief Infection pressure brought to a cell by long-range travel: sum(j, T(i, j) * x(j, b)) over the open origins,
+         * for each age group b
+         *
+         * @param row Row of the cell
+         * @param time Current time
+         * @return double const* One value per age group of the config
+        */
+        double const* travel_pressure(unsigned int row, T time)
+        {
+            if (!computed || time != computed_time)
+                compute(time);
+
+            return travel_pressures.data() + position[row] * num_age_groups;
+        }
+
+        // What the far_field approximation did so far, nullptr without one
+        far_field::report_type const* far_field_report() const
+        {
+            return config->far_field_clusters.empty() ? nullptr : &clusters.get_report();
+        }
+
+    private:
+        shared_ptr<simulation_config const> config;
+        shared_ptr<timeline const> events;
+        unsigned int const num_age_groups; // Of the config. The loads and pressures of row i are at i * num_age_groups
+        bool const border_pressure; // Whether the sum over the neighborhoods is computed here
+
+        // Rows, and the row of the engine for each row given by add_cell()
+        vector<string> ids;
+        unordered_map<string, unsigned int> row_ids;
+        vector<unsigned int> position;
+        vector<unsigned int> row_begin{0};
+        vector<unsigned int> self_edges;
+
+        // Edges in CSR order
+        vector<string> edge_ids;
+        vector<vicinity> edges;
+        vector<unsigned int> columns;
+        vector<hysteresis_factor> hysteresis;
+        vector<double> values;
+
+        struct timed_summary
+        {
+            T time{};
+            shared_ptr<infectious_summary const> summary;
+        };
+        vector<timed_summary> published, pending;
+
+        travel_network travel;
+        vector<bool> open_origins; // Whether the travel_restriction lets people travel out of each cell
+        vector<double> travel_loads; // x(j, b), or 0 for the cells that aren't open origins
+        far_field clusters;
+        vector<double> age_loads;    // travel_loads of a single age group, for the far_field
+
+        vector<double> loads, pressures, travel_pressures;
+        mutable vector<Summation::sum<double>> row_sums; // Of the row being multiplied, one per age group
+        bool assembled = false, computed = false;
+        T computed_time{};
+
+        void assemble()
+        {
+            renumber();
+
+            columns.reserve(edge_ids.size());
+            for (string const& id : edge_ids)
+            {
+                auto found = row_ids.find(id);
+                AssertLong(found != row_ids.end(), __FILE__, __LINE__, "The neighbor " + id + " isn't a cell of the model");
+                columns.push_back(found->second);
+            }
+
+            hysteresis.assign(edges.size(), hysteresis_factor{});
+            values.assign(edges.size(), 0.0);
+            loads.assign(ids.size() * num_age_groups, 0.0);
+            pressures.assign(ids.size() * num_age_groups, 0.0);
+            row_sums.assign(num_age_groups, 0.0);
+
+            if (has_travel())
+                travel.resolve(ids.size(), row_ids);
+            if (!config->far_field_clusters.empty())
+                clusters.build(ids, travel);
+            open_origins.assign(ids.size(), false);
+            travel_pressures.assign(ids.size() * num_age_groups, 0.0);
+            travel_loads.assign(ids.size() * num_age_groups, 0.0);
+            age_loads.assign(ids.size(), 0.0);
+            assembled = true;
+        }
+
+        // Moves the rows to their reverse Cuthill-McKee order (see Helpers/Ordering.hpp), each with its edges in the same order
+        void renumber()
+        {
+            unsigned int const count = ids.size();
+            vector<vector<unsigned int>> adjacency(count);
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                for (unsigned int e = row_begin.at(i); e < row_begin.at(i + 1); ++e)
+                {
+                    auto found = row_ids.find(edge_ids.at(e));
+                    if (found != row_ids.end() && found->second != i)
+                        adjacency.at(i).push_back(found->second);
+                }
+            }
+
+            vector<string> ordered_ids, ordered_edge_ids;
+            vector<vicinity> ordered_edges;
+            vector<unsigned int> ordered_begin{0}, ordered_self_edges;
+            vector<timed_summary> ordered_published, ordered_pending;
+
+            for (unsigned int i : Ordering::reverse_cuthill_mckee(adjacency))
+            {
+                position.at(i) = ordered_ids.size();
+                row_ids.at(ids.at(i)) = ordered_ids.size();
+                ordered_ids.push_back(ids.at(i));
+
+                for (unsigned int e = row_begin.at(i); e < row_begin.at(i + 1); ++e)
+                {
+                    if (e == self_edges.at(i))
+                        ordered_self_edges.push_back(ordered_edges.size());
+                    ordered_edge_ids.push_back(edge_ids.at(e));
+                    ordered_edges.push_back(edges.at(e));
+                }
+                ordered_begin.push_back(ordered_edges.size());
+
+                ordered_published.push_back(move(published.at(i)));
+                ordered_pending.push_back(move(pending.at(i)));
+            }
+
+            ids        = move(ordered_ids);
+            edge_ids   = move(ordered_edge_ids);
+            edges      = move(ordered_edges);
+            row_begin  = move(ordered_begin);
+            self_edges = move(ordered_self_edges);
+            published  = move(ordered_published);
+            pending    = move(ordered_pending);
+        }
+
+        // x(j, b): infectious load of each age group of a cell weighted by the mobility and virulence rates
+        void load(infectious_summary const& summary, double* age_loads) const
+        {
+            AssertLong(summary.num_age_groups <= num_age_groups, __FILE__, __LINE__, "A cell has more age groups than the config");
+            fill(age_loads, age_loads + num_age_groups, 0.0);
+
+            // As in geographical_cell::neighborhood_pressure() the inner sum carries over from one age group to the next,
+            // unless a contact matrix weighs each age group on its own
+            Summation::sum<double> inner_sum = 0;
+            for (unsigned int age_group = 0; age_group < summary.num_age_groups; ++age_group)
+            {
+                if (!config->contact_matrix.empty())
+                    inner_sum = 0;
+
+                for (auto pop_type : {infectious_summary::NVAC, infectious_summary::DOSE1, infectious_summary::DOSE2})
+                {
+                    if (pop_type != infectious_summary::NVAC && !config->is_vaccination)
+                        break;
+
+                    proportion const* infected = summary.infected(pop_type, age_group);
+                    for (unsigned int n = 0; n < summary.num_infected_phases(pop_type, age_group); ++n)
+                        inner_sum += value_of(config->mobility_rates.at(age_group).at(n)) * value_of(config->virulence_rates.at(age_group).at(n)) * value_of(infected[n]);
+                }
+
+                age_loads[age_group] = inner_sum * summary.age_group_proportions.at(age_group);
+            }
+        }
+
+        // Same policy as geographical_cell::travel_international(), which for "partial" must hold in every age group
+        bool is_open_origin(infectious_summary const& summary) const
+        {
+            if (config->travel == travel_policy::total)
+                return false;
+
+            if (config->travel == travel_policy::partial)
+            {
+                for (unsigned int age_group = 0; age_group < summary.num_age_groups; ++age_group)
+                {
+                    if (!((summary.vaccinatedD2.at(age_group) > 0.75 || summary.recovered.at(age_group) > 0.75)
+                            && summary.infections.at(age_group) < 0.2))
+                        return false;
+                }
+            }
+
+            return true;
+        }
+
+        void compute(T time)
+        {
+            if (!assembled)
+                assemble();
+            if (events)
+                config = events->config_at(time);
+
+            for (unsigned int j = 0; j < ids.size(); ++j)
+            {
+                if (pending.at(j).summary && !(time < pending.at(j).time))
+                {
+                    published.at(j)    = move(pending.at(j));
+                    pending.at(j)      = timed_summary{};
+                    load(*published.at(j).summary, loads.data() + j * num_age_groups);
+                    open_origins.at(j) = is_open_origin(*published.at(j).summary);
+                }
+            }
+
+            if (border_pressure)
+                compute_border_pressures();
+
+            if (has_travel())
+                compute_travel_pressures();
+
+            computed      = true;
+            computed_time = time;
+        }
+
+        void compute_border_pressures()
+        {
+            // Assemble A(i, j) = cij * kij. A neighbor can't be less restricted than the cell itself
+            for (unsigned int i = 0; i < ids.size(); ++i)
+            {
+                infectious_summary const& self = *published.at(i).summary;
+                unsigned int const self_edge   = self_edges.at(i);
+                double const self_correction   = value_of(self.disobedient) + (1 - value_of(self.disobedient))
+                                                    * movement_correction_factor(edges.at(self_edge).correction_factors,
+                                                                                self.total_infections, hysteresis.at(self_edge));
+
+                for (unsigned int e = row_begin.at(i); e < row_begin.at(i + 1); ++e)
+                {
+                    infectious_summary const& neighbor = *published.at(columns.at(e)).summary;
+                    double const correction = value_of(neighbor.disobedient) + (1 - value_of(neighbor.disobedient))
+                                                * movement_correction_factor(edges.at(e).correction_factors,
+                                                                            neighbor.total_infections, hysteresis.at(e));
+
+                    values.at(e) = edges.at(e).correlation * min(self_correction, correction);
+                }
+            }
+
+            // y = A * x, with a block of num_age_groups values per entry
+            for (unsigned int i = 0; i < ids.size(); ++i)
+            {
+                fill(row_sums.begin(), row_sums.end(), 0.0);
+                for (unsigned int e = row_begin[i]; e < row_begin[i + 1]; ++e)
+                {
+                    double const* x = loads.data() + columns[e] * num_age_groups;
+                    for (unsigned int b = 0; b < num_age_groups; ++b)
+                        row_sums[b] += values[e] * x[b];
+                }
+
+                copy(row_sums.begin(), row_sums.end(), pressures.data() + i * num_age_groups);
+            }
+        }
+
+        void compute_travel_pressures()
+        {
+            for (unsigned int k = 0; k < travel_loads.size(); ++k)
+                travel_loads[k] = open_origins[k / num_age_groups] ? loads[k] : 0.0;
+
+            if (config->far_field_clusters.empty())
+            {
+                for (unsigned int i = 0; i < ids.size(); ++i)
+                    exact_travel_pressure(i, travel_pressures.data() + i * num_age_groups);
+                return;
+            }
+
+            // The clusters approximate one age group at a time, each within the tolerance
+            for (unsigned int b = 0; b < num_age_groups; ++b)
+            {
+                for (unsigned int j = 0; j < ids.size(); ++j)
+                    age_loads[j] = travel_loads[j * num_age_groups + b];
+
+                clusters.update(age_loads);
+                for (unsigned int i = 0; i < ids.size(); ++i)
+                    travel_pressures[i * num_age_groups + b] = clusters.evaluate(i, travel, age_loads, config->far_field_tolerance);
+            }
+
+            if (config->far_field_check)
+            {
+                vector<double> exact(num_age_groups);
+                for (unsigned int i = 0; i < ids.size(); ++i)
+                {
+                    exact_travel_pressure(i, exact.data());
+                    for (unsigned int b = 0; b < num_age_groups; ++b)
+                        clusters.check(travel_pressures[i * num_age_groups + b], exact[b]);
+                }
+            }
+        }
+
+        // y(i, b) = sum(j, T(i, j) * x(j, b)) over the open origins
+        void exact_travel_pressure(unsigned int i, double* sum) const
+        {
+            fill(row_sums.begin(), row_sums.end(), 0.0);
+            for (unsigned int f = travel.flows_begin[i]; f < travel.flows_begin[i + 1]; ++f)
+            {
+                double const* x = travel_loads.data() + travel.origins[f] * num_age_groups;
+                for (unsigned int b = 0; b < num_age_groups; ++b)
+                    row_sums[b] += travel.correlations[f] * x[b];
+            }
+
+            copy(row_sums.begin(), row_sums.end(), sum);
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_PRESSURE_ENGINE_HPP
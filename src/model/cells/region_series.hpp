@@ -0,0 +1,61 @@
+#ifndef PANDEMIC_HOYA_2002_REGION_SERIES_HPP
+#define PANDEMIC_HOYA_2002_REGION_SERIES_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sevirds.hpp"
+#include "../Helpers/Assert.hpp"
+
+using namespace std;
+
+/**
+ * The current value of one total of some regions, in people: "infected", "new_infected" (the first day of the infected
+ * phases) or "deaths". The cells of those regions report their state to it whenever it changes, so a simulation run
+ * one day at a time can be compared to observed series without writing or parsing a state log (see calibration.hpp).
+*/
+class region_series
+{
+    public:
+        region_series(vector<string> const& regions, string const& total_name) : values(regions.size(), 0.0)
+        {
+            total = total_name == "infected" ? infected : total_name == "new_infected" ? new_infected : deaths;
+            Assert::AssertLong(total != deaths || total_name == "deaths", __FILE__, __LINE__,
+                        "The series must be \"infected\", \"new_infected\" or \"deaths\", not \"" + total_name + "\"");
+
+            for (unsigned int i = 0; i < regions.size(); ++i)
+                rows.insert({regions.at(i), i});
+        }
+
+        // Row of a region, or -1 when its total isn't followed
+        int row_of(string const& region) const
+        {
+            auto found = rows.find(region);
+            return found == rows.end() ? -1 : (int)found->second;
+        }
+
+        /**
+         * @brief Records the new state of a region
+         *
+         * @param row Row of the region
+         * @param state New state of the region
+        */
+        void report(unsigned int row, sevirds const& state)
+        {
+            scalar share = total == infected     ? state.get_total_infections()
+                         : total == new_infected ? state.get_total_new_infections()
+                         : state.get_total_fatalities();
+
+            values.at(row) = value_of(share) * state.population;
+        }
+
+        // Total of the region of a row, from its last state
+        double value(unsigned int row) const { return values.at(row); }
+
+    private:
+        enum total_type { infected, new_infected, deaths } total;
+        unordered_map<string, unsigned int> rows;
+        vector<double> values;
+};
+
+#endif //PANDEMIC_HOYA_2002_REGION_SERIES_HPP
@@ -0,0 +1,105 @@
+#ifndef PANDEMIC_HOYA_2002_SENSITIVITY_LOG_HPP
+#define PANDEMIC_HOYA_2002_SENSITIVITY_LOG_HPP
+
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+#include "sevirds.hpp"
+
+using namespace std;
+
+/**
+ * Daily totals of the model, over every cell, and their derivatives with respect to the config's sensitivity
+ * parameters (see simulation_config::sensitivity). Needs a build with SENSITIVITY=<n>, where the states carry
+ * the derivatives of every proportion (see Dual.hpp).
+ *
+ * Each cell reports its state whenever it changes. Its share of the totals is kept until its next report, so the
+ * cells that don't change on a day still count, and the totals of a day are the sum of the changes up to that day.
+*/
+class sensitivity_log
+{
+    public:
+        // The totals, in people: infected, new infected and deaths
+        static constexpr unsigned int num_totals = 3;
+        using totals_type = array<scalar, num_totals>;
+
+        explicit sensitivity_log(vector<string> parameters) : parameters{move(parameters)} { }
+
+        vector<string> const& parameter_names() const { return parameters; }
+
+        // Adds a cell and returns its row, which it reports with
+        unsigned int add_cell()
+        {
+            shares.emplace_back();
+            return shares.size() - 1;
+        }
+
+        /**
+         * @brief Records the state of a cell from a given time on
+         *
+         * @param row Row of the cell
+         * @param time Time of the state
+         * @param state New state of the cell
+        */
+        void report(unsigned int row, double time, sevirds const& state)
+        {
+            totals_type const share = {state.get_total_infections() * state.population, state.get_total_new_infections() * state.population,
+                                        state.get_total_fatalities() * state.population};
+
+            totals_type& change = changes[time];
+            for (unsigned int k = 0; k < num_totals; ++k)
+            {
+                change[k] += share[k] - shares.at(row)[k];
+                shares.at(row)[k] = share[k];
+            }
+        }
+
+        /**
+         * @brief Writes the totals of every day a cell changed, and their derivatives, as CSV. The derivative of a total
+         * with respect to a parameter is the change of the total when the parameter is multiplied by (1 + h), divided by h
+         *
+         * @param file_path Path of the file
+        */
+        void write(string const& file_path) const
+        {
+            ofstream out{file_path};
+            if (!out.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+            out << setprecision(12);
+
+            char const* names[num_totals] = {"infected", "new_infected", "deaths"};
+            out << "time";
+            for (unsigned int k = 0; k < num_totals; ++k)
+            {
+                out << "," << names[k];
+                for (string const& parameter : parameters)
+                    out << ",d_" << names[k] << "/d_" << parameter;
+            }
+            out << endl;
+
+            totals_type totals{};
+            for (auto const& change : changes)
+            {
+                out << change.first;
+                for (unsigned int k = 0; k < num_totals; ++k)
+                {
+                    totals[k] += change.second[k];
+
+                    out << "," << value_of(totals[k]);
+                    for (unsigned int i = 0; i < parameters.size(); ++i)
+                        out << "," << derivative_of(totals[k], i);
+                }
+                out << endl;
+            }
+        }
+
+    private:
+        vector<string> parameters;
+        vector<totals_type> shares;       // Share of the totals of each cell, from its last report
+        map<double, totals_type> changes; // Change of the totals at each time
+};
+
+#endif //PANDEMIC_HOYA_2002_SENSITIVITY_LOG_HPP
@@ -4,14 +4,49 @@
 #ifndef PANDEMIC_HOYA_2002_SEIRD_HPP
 #define PANDEMIC_HOYA_2002_SEIRD_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <nlohmann/json.hpp>
-#include "hysteresis_factor.hpp"
+#include "infectious_summary.hpp"
 #include "../Helpers/Assert.hpp"
+#include "../Helpers/CopyOnWrite.hpp"
+#include "../Helpers/Dual.hpp"
+#include "../Helpers/Summation.hpp"
 
 using namespace std;
 using namespace Assert;
 
+// Type used to store the proportions of the compartments. Building with -DFLOAT32=Y
+// halves the size of the state; sums and totals are still accumulated in double (scalar).
+// With -DSENSITIVITY=<n> they are dual numbers that carry their derivatives (see Dual.hpp)
+#if defined(SEVIRDS_SENSITIVITY)
+    using proportion = scalar;
+#elif defined(SEVIRDS_FLOAT32)
+    using proportion = float;
+#else
+    using proportion = double;
+#endif
+
+using infectious_summary = infectious_summary_t<proportion>;
+
+/**
+ * Largest move of a proportion while the next state of a cell is computed from the current one, measured as the
+ * equations write each proportion (see geographical_cell::next_state()). It stays 0 if the state doesn't change,
+ * which spares comparing every phase of the two states afterwards
+*/
+struct change_meter
+{
+    double largest = 0;
+
+    void write(proportion& slot, scalar const& value)
+    {
+        proportion const before = slot;
+        slot    = value;
+        largest = max(largest, abs(value_of(slot) - value_of(before)));
+    }
+};
+
 /**
  * Keeps track of the model data and is initially
  * populated by what is store under the "state"
@@ -19,47 +54,47 @@ using namespace Assert;
 */
 struct sevirds
 {
-    using proportionVector = vector<vector<double>>;    // { {doubles}, {doubles},   ......... }
-                                                        //   ageGroup1  ageGroup2    ageGroup#
+    using proportionVector = vector<vector<proportion>>;    // { {proportions}, {proportions},   ......... }
+                                                            //   ageGroup1      ageGroup2        ageGroup#
+    using rateVector       = vector<vector<double>>;
 
     double population;
-    vector<double> age_group_proportions;
+    copy_on_write<vector<double>> age_group_proportions;
 
     // Susceptible
-    proportionVector susceptible;
-    proportionVector vaccinatedD1;
-    proportionVector vaccinatedD2;
+    copy_on_write<proportionVector> susceptible;
+    copy_on_write<proportionVector> vaccinatedD1;
+    copy_on_write<proportionVector> vaccinatedD2;
 
     // Exposed
-    proportionVector exposed;
-    proportionVector exposedD1;
-    proportionVector exposedD2;
+    copy_on_write<proportionVector> exposed;
+    copy_on_write<proportionVector> exposedD1;
+    copy_on_write<proportionVector> exposedD2;
 
     // Infected
-    proportionVector infected;
-    proportionVector infectedD1;
-    proportionVector infectedD2;
+    copy_on_write<proportionVector> infected;
+    copy_on_write<proportionVector> infectedD1;
+    copy_on_write<proportionVector> infectedD2;
 
     // Recovered
-    proportionVector recovered;
-    proportionVector recoveredD1;
-    proportionVector recoveredD2;
+    copy_on_write<proportionVector> recovered;
+    copy_on_write<proportionVector> recoveredD1;
+    copy_on_write<proportionVector> recoveredD2;
 
     // Fatalities
-    vector<double> fatalities;
+    copy_on_write<vector<proportion>> fatalities;
 
     // Modifiers
-    double disobedient;
+    scalar disobedient;
     double hospital_capacity;
-    double fatality_modifier;
+    scalar fatality_modifier;
 
     // Vaccines
-    proportionVector immunityD1_rate;
-    proportionVector immunityD2_rate;
+    copy_on_write<rateVector> immunityD1_rate;
+    copy_on_write<rateVector> immunityD2_rate;
     unsigned int min_interval_doses;
     unsigned int min_interval_recovery_to_vaccine;
 
-    unordered_map<string, hysteresis_factor> hysteresis_factors;
     unsigned int num_age_groups;
 
     bool vaccines;       // Are vaccines being modelled?
@@ -70,6 +105,13 @@ struct sevirds
     // so do it once at the start then multiply by the decimal value
     double one_over_prec_divider;
 
+    // Incremented by geographical_cell::local_computation() whenever the new state differs from
+    // the previous one, so that Cadmium can tell if the state changed without comparing every phase
+    unsigned long version = 0;
+
+    // What the neighbors read from this state. Set by summarize()
+    shared_ptr<infectious_summary const> summary;
+
     // Required for the JSON library, as types used with it must be default-constructable.
     // The overloaded constructor results in a default constructor having to be manually written.
     sevirds()
@@ -83,8 +125,8 @@ struct sevirds
             proportionVector exp, proportionVector exp1, proportionVector exp2,
             proportionVector inf, proportionVector inf1, proportionVector inf2,
             proportionVector rec, proportionVector rec1, proportionVector rec2,
-            vector<double> fat, double dis, double hcap, double fatm, proportionVector immuD1, unsigned int min_interval,
-            proportionVector immuD2, double divider, bool vac=false) :
+            vector<proportion> fat, scalar dis, double hcap, scalar fatm, rateVector immuD1, unsigned int min_interval,
+            rateVector immuD2, double divider, bool vac=false) :
                 population{pop},
                 susceptible{move(sus)},
                 vaccinatedD1{move(vac1)},
@@ -108,36 +150,42 @@ struct sevirds
                 vaccines(vac),
                 prec_divider(divider),
                 one_over_prec_divider(1.0 / divider)
-    { num_age_groups = age_group_proportions.size(); }
+    { num_age_groups = age_group_proportions->size(); }
 
     // GETTERS
     unsigned int get_num_age_segments() const       { return num_age_groups;                }
-    unsigned int get_num_exposed_phases() const     { return exposed.front().size();        }
-    unsigned int get_num_infected_phases() const    { return infected.front().size();       }
-    unsigned int get_num_recovered_phases() const   { return recovered.front().size();      }
-    unsigned int get_num_vaccinated1_phases() const { return vaccinatedD1.front().size();   }
-    unsigned int get_num_vaccinated2_phases() const { return vaccinatedD2.front().size();   }
-    unsigned int get_immunity1_num_weeks() const    { return immunityD1_rate.size();        }
-    unsigned int get_immunity2_num_weeks() const    { return immunityD2_rate.size();        }
+    unsigned int get_num_exposed_phases() const     { return exposed->front().size();        }
+    unsigned int get_num_infected_phases() const    { return infected->front().size();       }
+    unsigned int get_num_recovered_phases() const   { return recovered->front().size();      }
+    unsigned int get_num_vaccinated1_phases() const { return vaccinatedD1->front().size();   }
+    unsigned int get_num_vaccinated2_phases() const { return vaccinatedD2->front().size();   }
+    unsigned int get_immunity1_num_weeks() const    { return immunityD1_rate->size();        }
+    unsigned int get_immunity2_num_weeks() const    { return immunityD2_rate->size();        }
 
     /**
      * @brief Sums all the values in a vector
      * 
      * @param state_vector Vector to be summed
-     * @return double
+     * @return scalar
     */
-    static double sum_state_vector(const vector<double>& state_vector) { return accumulate(state_vector.begin(), state_vector.end(), 0.0); }
+    static scalar sum_state_vector(const vector<proportion>& state_vector)
+    {
+        Summation::sum<scalar> sum = 0;
+        for (proportion const& value : state_vector)
+            sum += value;
+        return sum;
+    }
 
     /**
      * @brief Get the total susceptible population count. This includes those who are
      * vaccinated unless specified with the bool.
      * 
      * @param getNVac Used when only wanting to get the non-vaccinated susceptible population.
-     * @return double
+     * @return scalar
     */
-    double get_total_susceptible(bool getNVac=false, int age_group=-1) const
+    scalar get_total_susceptible(bool getNVac=false, int age_group=-1) const
     {
-        double total_susceptible = 0;
+        Summation::sum<scalar> total_susceptible = 0;
 
         if (age_group == -1)
         {
@@ -145,24 +193,24 @@ struct sevirds
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated
-                total_susceptible += susceptible.at(i).front() * age_group_proportions.at(i);
+                total_susceptible += susceptible->at(i).front() * age_group_proportions->at(i);
 
                 // Total vaccianted (Dose1 + Dose2)
                 if (vaccines && !getNVac)
                 {
-                    total_susceptible += sum_state_vector(vaccinatedD1.at(i)) * age_group_proportions.at(i);
-                    total_susceptible += sum_state_vector(vaccinatedD2.at(i)) * age_group_proportions.at(i);
+                    total_susceptible += sum_state_vector(vaccinatedD1->at(i)) * age_group_proportions->at(i);
+                    total_susceptible += sum_state_vector(vaccinatedD2->at(i)) * age_group_proportions->at(i);
                 }
             }
         }
         else
         {
-            total_susceptible = susceptible.at(age_group).front();
+            total_susceptible = susceptible->at(age_group).front();
 
             if (vaccines)
             {
-                total_susceptible += sum_state_vector(vaccinatedD1.at(age_group));
-                total_susceptible += sum_state_vector(vaccinatedD2.at(age_group));
+                total_susceptible += sum_state_vector(vaccinatedD1->at(age_group));
+                total_susceptible += sum_state_vector(vaccinatedD2->at(age_group));
             }
         }
 
@@ -173,22 +221,22 @@ struct sevirds
      * @brief Gets the total susceptible group with their first dose
      * 
      * @param age_group Will only return the total for that age group
-     * @return double 
+     * @return scalar
      */
-    double get_total_vaccinatedD1(int age_group=-1) const
+    scalar get_total_vaccinatedD1(int age_group=-1) const
     {
-        double total_vaccinatedD1 = 0;
+        Summation::sum<scalar> total_vaccinatedD1 = 0;
 
         if (age_group == -1)
         {
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total vaccinated Dose 1
-                total_vaccinatedD1 += sum_state_vector(vaccinatedD1.at(i)) * age_group_proportions.at(i);
+                total_vaccinatedD1 += sum_state_vector(vaccinatedD1->at(i)) * age_group_proportions->at(i);
             }
         }
         else
-            total_vaccinatedD1 = sum_state_vector(vaccinatedD1.at(age_group));
+            total_vaccinatedD1 = sum_state_vector(vaccinatedD1->at(age_group));
 
         return total_vaccinatedD1;
     }
@@ -197,22 +245,22 @@ struct sevirds
      * @brief Gets the total susceptible group with their second dose
      * 
      * @param age_group Returns the total for those in that age group
-     * @return double 
+     * @return scalar
      */
-    double get_total_vaccinatedD2(int age_group=-1) const
+    scalar get_total_vaccinatedD2(int age_group=-1) const
     {
-        double total_vaccinatedD2 = 0;
+        Summation::sum<scalar> total_vaccinatedD2 = 0;
 
         if (age_group == -1)
         {
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total vaccinated Dose 2
-                total_vaccinatedD2 += sum_state_vector(vaccinatedD2.at(i)) * age_group_proportions.at(i);
+                total_vaccinatedD2 += sum_state_vector(vaccinatedD2->at(i)) * age_group_proportions->at(i);
             }
         }
         else
-            total_vaccinatedD2 = sum_state_vector(vaccinatedD2.at(age_group));
+            total_vaccinatedD2 = sum_state_vector(vaccinatedD2->at(age_group));
 
         return total_vaccinatedD2;
     }
@@ -221,35 +269,35 @@ struct sevirds
      * @brief Gets the total of those exposed including those vaccinated
      * 
      * @param age_group Returns only the total for the specified age group 
-     * @return double 
+     * @return scalar
      */
-    double get_total_exposed(int age_group=-1) const
+    scalar get_total_exposed(int age_group=-1) const
     {
-        double total_exposed = 0;
+        Summation::sum<scalar> total_exposed = 0;
 
         if (age_group == -1)
         {
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated exposed
-                total_exposed += sum_state_vector(exposed.at(i)) * age_group_proportions.at(i);
+                total_exposed += sum_state_vector(exposed->at(i)) * age_group_proportions->at(i);
 
                 // Total vaccinated exposed (Dose1 + Dose2)
                 if (vaccines)
                 {
-                    total_exposed += sum_state_vector(exposedD1.at(i)) * age_group_proportions.at(i);
-                    total_exposed += sum_state_vector(exposedD2.at(i)) * age_group_proportions.at(i);
+                    total_exposed += sum_state_vector(exposedD1->at(i)) * age_group_proportions->at(i);
+                    total_exposed += sum_state_vector(exposedD2->at(i)) * age_group_proportions->at(i);
                 }
             }
         }
         else
         {
-            total_exposed += sum_state_vector(exposed.at(age_group));
+            total_exposed += sum_state_vector(exposed->at(age_group));
 
             if (vaccines)
             {
-                total_exposed += sum_state_vector(exposedD1.at(age_group));
-                total_exposed += sum_state_vector(exposedD2.at(age_group));
+                total_exposed += sum_state_vector(exposedD1->at(age_group));
+                total_exposed += sum_state_vector(exposedD2->at(age_group));
             }
         }
 
@@ -260,75 +308,98 @@ struct sevirds
      * @brief Returns the total infected population inlcuding those who are vaccinated
      * 
      * @param age_group Specifies the age group to compute the total
-     * @return double 
+     * @return scalar
      */
-    double get_total_infections(int age_group=-1) const
+    scalar get_total_infections(int age_group=-1) const
     {
-        double total_infections = 0;
+        Summation::sum<scalar> total_infections = 0;
 
         if (age_group == -1)
         {
             for (unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated infected
-                total_infections += sum_state_vector(infected.at(i)) * age_group_proportions.at(i);
+                total_infections += sum_state_vector(infected->at(i)) * age_group_proportions->at(i);
 
                 // Total vaccinated infected (Dose1 + Dose2)
                 if (vaccines)
                 {
-                    total_infections += sum_state_vector(infectedD1.at(i)) * age_group_proportions.at(i);
-                    total_infections += sum_state_vector(infectedD2.at(i)) * age_group_proportions.at(i);
+                    total_infections += sum_state_vector(infectedD1->at(i)) * age_group_proportions->at(i);
+                    total_infections += sum_state_vector(infectedD2->at(i)) * age_group_proportions->at(i);
                 }
             }
         }
         else
         {
-            total_infections += sum_state_vector(infected.at(age_group));
+            total_infections += sum_state_vector(infected->at(age_group));
 
             if (vaccines)
             {
-                total_infections += sum_state_vector(infectedD1.at(age_group));
-                total_infections += sum_state_vector(infectedD2.at(age_group));
+                total_infections += sum_state_vector(infectedD1->at(age_group));
+                total_infections += sum_state_vector(infectedD2->at(age_group));
             }
         }
 
         return total_infections;
     }
 
+    /**
+     * @brief Returns the new infections of the day (the first day of every infected phase) including those who are vaccinated
+     *
+     * @return scalar
+     */
+    scalar get_total_new_infections() const
+    {
+        Summation::sum<scalar> new_infections = 0;
+
+        for (unsigned int i = 0; i < num_age_groups; ++i)
+        {
+            new_infections += infected->at(i).front() * age_group_proportions->at(i);
+
+            if (vaccines)
+            {
+                new_infections += infectedD1->at(i).front() * age_group_proportions->at(i);
+                new_infections += infectedD2->at(i).front() * age_group_proportions->at(i);
+            }
+        }
+
+        return new_infections;
+    }
+
     /**
      * @brief Returns the total number of those in the recovery phase
      * including those who are vaccinated
      * 
      * @param age_group Returns the total for the specified age group
-     * @return double 
+     * @return scalar
      */
-    double get_total_recovered(int age_group=-1) const
+    scalar get_total_recovered(int age_group=-1) const
     {
-        double total_recoveries = 0;
+        Summation::sum<scalar> total_recoveries = 0;
 
         if (age_group == -1)
         {
             for(unsigned int i = 0; i < num_age_groups; ++i)
             {
                 // Total non-vaccinated recoveries
-                total_recoveries += sum_state_vector(recovered.at(i)) * age_group_proportions.at(i);
+                total_recoveries += sum_state_vector(recovered->at(i)) * age_group_proportions->at(i);
 
                 // Total vaccinated recoveries (Dose1 + Dose2)
                 if (vaccines)
                 {
-                    total_recoveries += sum_state_vector(recoveredD1.at(i)) * age_group_proportions.at(i);
-                    total_recoveries += sum_state_vector(recoveredD2.at(i)) * age_group_proportions.at(i);
+                    total_recoveries += sum_state_vector(recoveredD1->at(i)) * age_group_proportions->at(i);
+                    total_recoveries += sum_state_vector(recoveredD2->at(i)) * age_group_proportions->at(i);
                 }
             }
         }
         else
         {
-            total_recoveries += sum_state_vector(recovered.at(age_group));
+            total_recoveries += sum_state_vector(recovered->at(age_group));
 
             if (vaccines)
             {
-                total_recoveries += sum_state_vector(recoveredD1.at(age_group));
-                total_recoveries += sum_state_vector(recoveredD2.at(age_group));
+                total_recoveries += sum_state_vector(recoveredD1->at(age_group));
+                total_recoveries += sum_state_vector(recoveredD2->at(age_group));
             }
         }
 
@@ -338,25 +409,117 @@ struct sevirds
     /**
      * @brief Returns the total fataltities
      * 
-     * @return double 
+     * @return scalar
      */
-    double get_total_fatalities() const
+    scalar get_total_fatalities() const
     {
-        double total_fatalities = 0.0f;
+        Summation::sum<scalar> total_fatalities = 0.0;
 
         for (unsigned int i = 0; i < num_age_groups; ++i)
-            total_fatalities += fatalities.at(i) * age_group_proportions.at(i);
+            total_fatalities += fatalities->at(i) * age_group_proportions->at(i);
 
         return total_fatalities;
     }
 
-    bool operator!=(const sevirds& other) const
+    /**
+     * @brief Whether nobody is in any phase of the infected groups (non-vac, dose 1 and dose 2).
+     * Such a cell doesn't add anything to the new exposures of its neighbors
+     *
+     * @return bool
+     */
+    bool is_not_infectious() const
     {
-        return  (susceptible != other.susceptible) || (vaccinatedD1 != other.vaccinatedD1) || (vaccinatedD2 != other.vaccinatedD2) ||
-                (exposed != other.exposed) || (exposedD1 != other.exposedD1) || (exposedD2 != other.exposedD2) ||
-                (infected != other.infected) || (infectedD1 != other.infectedD1) || (infectedD2 != other.infectedD2) ||
-                (recovered != other.recovered) || (recoveredD1 != other.recoveredD1) || (recoveredD2 != other.recoveredD2) ||
-                (fatalities != other.fatalities);
+        for (unsigned int i = 0; i < num_age_groups; ++i)
+        {
+            if (any_of(infected->at(i).begin(), infected->at(i).end(), [](proportion p) { return p != 0; }))
+                return false;
+
+            if (vaccines && (any_of(infectedD1->at(i).begin(), infectedD1->at(i).end(), [](proportion p) { return p != 0; })
+                            || any_of(infectedD2->at(i).begin(), infectedD2->at(i).end(), [](proportion p) { return p != 0; })))
+                return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Whether the exposed, infected and recovered groups are all exactly empty.
+     * The EIRD equations leave such a cell unchanged as long as none of its neighbors are infectious
+     *
+     * @return bool
+     */
+    bool is_infection_free() const
+    {
+        auto is_empty = [](copy_on_write<proportionVector> const& phases, unsigned int i)
+                        { return all_of(phases->at(i).begin(), phases->at(i).end(), [](proportion p) { return p == 0; }); };
+
+        if (!is_not_infectious())
+            return false;
+
+        for (unsigned int i = 0; i < num_age_groups; ++i)
+        {
+            if (!is_empty(exposed, i) || !is_empty(recovered, i))
+                return false;
+
+            if (vaccines && (!is_empty(exposedD1, i) || !is_empty(exposedD2, i) || !is_empty(recoveredD1, i) || !is_empty(recoveredD2, i)))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Cadmium sends a state to the neighbors (and logs it) only if this is true. See change_meter
+    bool operator!=(const sevirds& other) const { return version != other.version; }
+
+    /**
+     * @brief Builds the summary the neighbors read (see infectious_summary.hpp).
+     * Must be called again whenever the state changes
+     */
+    void summarize()
+    {
+        auto res = make_shared<infectious_summary>();
+
+        res->num_age_groups        = num_age_groups;
+        res->age_group_proportions = *age_group_proportions;
+        res->disobedient           = disobedient;
+        res->total_infections      = value_of(get_total_infections());
+        res->not_infectious        = is_not_infectious();
+
+        for (unsigned int i = 0; i < num_age_groups; ++i)
+        {
+            res->infections.push_back(value_of(get_total_infections(i)));
+            res->vaccinatedD2.push_back(value_of(get_total_vaccinatedD2(i)));
+            res->recovered.push_back(value_of(get_total_recovered(i)));
+        }
+
+        for (proportionVector const* phases : {&*infected, &*infectedD1, &*infectedD2})
+        {
+            for (unsigned int i = 0; i < num_age_groups; ++i)
+            {
+                res->phase_begin.push_back(res->infected_phases.size());
+                res->infected_phases.insert(res->infected_phases.end(), phases->at(i).begin(), phases->at(i).end());
+            }
+        }
+        res->phase_begin.push_back(res->infected_phases.size());
+
+        summary = move(res);
+    }
+
+    /**
+     * @brief Sets the derivatives of the modifiers of the state that the config's sensitivity lists, with respect
+     * to a relative change of each one (see simulation_config::sensitivity). Must be called before summarize()
+     *
+     * @param parameters The config's sensitivity
+     */
+    void seed_sensitivity(vector<string> const& parameters)
+    {
+        for (unsigned int i = 0; i < parameters.size(); ++i)
+        {
+            if (parameters.at(i) == "disobedient")
+                set_derivative(disobedient, i, value_of(disobedient));
+            else if (parameters.at(i) == "fatality_modifier")
+                set_derivative(fatality_modifier, i, value_of(fatality_modifier));
+        }
     }
 
     /**
@@ -369,17 +532,16 @@ struct sevirds
 }; //struct servids{}
 
 /**
- * @brief Outputs <population, S, E, VD1, VD2, I, R, new E, new I, new R, D>
- * 
- * @param os Out stream object to pipe into
+ * @brief The values of the state log: population, S, E, VD1, VD2, I, R, new E, new I, new R, D
+ *
  * @param sevirds Current simulation data
- * @return ostream& 
+ * @return array<double, 11>
  */
-ostream &operator<<(ostream& os, const sevirds& sevirds)
+array<double, 11> log_fields(const sevirds& sevirds)
 {
-    double new_exposed    = 0;
-    double new_infections = 0;
-    double new_recoveries = 0;
+    Summation::sum<scalar> new_exposed = 0;
+    Summation::sum<scalar> new_infections = 0;
+    Summation::sum<scalar> new_recoveries = 0;
 
     double age_group_proportion;
 
@@ -388,53 +550,67 @@ ostream &operator<<(ostream& os, const sevirds& sevirds)
     for (unsigned int i = 0; i < sevirds.num_age_groups; ++i)
     {
         // Get the age group
-        age_group_proportion = sevirds.age_group_proportions.at(i);
+        age_group_proportion = sevirds.age_group_proportions->at(i);
 
         // Non-Vaccinated
-        new_exposed    += sevirds.exposed.at(i).front()   * age_group_proportion; // Exposed
-        new_infections += sevirds.infected.at(i).front()  * age_group_proportion; // Infected
-        new_recoveries += sevirds.recovered.at(i).front() * age_group_proportion; // Recovered
+        new_exposed    += sevirds.exposed->at(i).front()   * age_group_proportion; // Exposed
+        new_infections += sevirds.infected->at(i).front()  * age_group_proportion; // Infected
+        new_recoveries += sevirds.recovered->at(i).front() * age_group_proportion; // Recovered
 
         // Vaccinated
         if (sevirds.vaccines)
         {
             // Dose 1
-            new_exposed    += sevirds.exposedD1.at(i).front()   * age_group_proportion;
-            new_infections += sevirds.infectedD1.at(i).front()  * age_group_proportion;
-            new_recoveries += sevirds.recoveredD1.at(i).front() * age_group_proportion;
+            new_exposed    += sevirds.exposedD1->at(i).front()   * age_group_proportion;
+            new_infections += sevirds.infectedD1->at(i).front()  * age_group_proportion;
+            new_recoveries += sevirds.recoveredD1->at(i).front() * age_group_proportion;
 
             // Dose 2
-            new_exposed    += sevirds.exposedD2.at(i).front()   * age_group_proportion;
-            new_infections += sevirds.infectedD2.at(i).front()  * age_group_proportion;
-            new_recoveries += sevirds.recoveredD2.at(i).front() * age_group_proportion;
+            new_exposed    += sevirds.exposedD2->at(i).front()   * age_group_proportion;
+            new_infections += sevirds.infectedD2->at(i).front()  * age_group_proportion;
+            new_recoveries += sevirds.recoveredD2->at(i).front() * age_group_proportion;
         }
     }
 
     // Precision corrrection
-    new_exposed    = sevirds.precision_divider(new_exposed);
-    new_infections = sevirds.precision_divider(new_infections);
-    new_recoveries = sevirds.precision_divider(new_recoveries);
+    double const exposed_today    = sevirds.precision_divider(value_of(new_exposed));
+    double const infections_today = sevirds.precision_divider(value_of(new_infections));
+    double const recoveries_today = sevirds.precision_divider(value_of(new_recoveries));
 
     // Calculate the totals from each day in every phase
-    double total_susceptible = sevirds.precision_divider(sevirds.get_total_susceptible(true));
-    double total_exposed     = sevirds.precision_divider(sevirds.get_total_exposed());
-    double total_infected    = sevirds.precision_divider(sevirds.get_total_infections());
-    double total_recovered   = sevirds.precision_divider(sevirds.get_total_recovered());
-    double total_fatalities  = sevirds.precision_divider(sevirds.get_total_fatalities());
+    double total_susceptible = sevirds.precision_divider(value_of(sevirds.get_total_susceptible(true)));
+    double total_exposed     = sevirds.precision_divider(value_of(sevirds.get_total_exposed()));
+    double total_infected    = sevirds.precision_divider(value_of(sevirds.get_total_infections()));
+    double total_recovered   = sevirds.precision_divider(value_of(sevirds.get_total_recovered()));
+    double total_fatalities  = sevirds.precision_divider(value_of(sevirds.get_total_fatalities()));
 
     // Susceptible Vaccinated
     double total_vaccinatedD1 = 0.0, total_vaccinatedD2 = 0.0;
     if (sevirds.vaccines)
     {
-        total_vaccinatedD1 = sevirds.precision_divider(sevirds.get_total_vaccinatedD1());
-        total_vaccinatedD2 = sevirds.precision_divider(sevirds.get_total_vaccinatedD2());
+        total_vaccinatedD1 = sevirds.precision_divider(value_of(sevirds.get_total_vaccinatedD1()));
+        total_vaccinatedD2 = sevirds.precision_divider(value_of(sevirds.get_total_vaccinatedD2()));
     }
 
-    // Pipe all the data
-    os << "<" << sevirds.population << "," << total_susceptible << "," << total_exposed << "," << total_vaccinatedD1
-        << "," << total_vaccinatedD2 << "," << total_infected << "," << total_recovered << "," << new_exposed
-        << "," << new_infections << "," << new_recoveries << "," << total_fatalities << ">";
-    return os;
+    return {sevirds.population, total_susceptible, total_exposed, total_vaccinatedD1, total_vaccinatedD2, total_infected,
+            total_recovered, exposed_today, infections_today, recoveries_today, total_fatalities};
+}
+
+/**
+ * @brief Outputs <population, S, E, VD1, VD2, I, R, new E, new I, new R, D>
+ * 
+ * @param os Out stream object to pipe into
+ * @param sevirds Current simulation data
+ * @return ostream& 
+ */
+ostream &operator<<(ostream& os, const sevirds& sevirds)
+{
+    array<double, 11> const fields = log_fields(sevirds);
+
+    os << "<" << fields[0];
+    for (unsigned int i = 1; i < fields.size(); ++i)
+        os << "," << fields[i];
+    return os << ">";
 }
 
 /**
@@ -446,70 +622,73 @@ ostream &operator<<(ostream& os, const sevirds& sevirds)
 void from_json(const nlohmann::json& json, sevirds& current_sevirds)
 {
     json.at("population").get_to(current_sevirds.population);
-    json.at("age_group_proportions").get_to(current_sevirds.age_group_proportions);
+    json.at("age_group_proportions").get_to(current_sevirds.age_group_proportions.edit());
 
-    try { json.at("susceptible").get_to(current_sevirds.susceptible); }
+    try { json.at("susceptible").get_to(current_sevirds.susceptible.edit()); }
     catch(nlohmann::detail::type_error &e) { AssertLong(false, __FILE__, __LINE__, "Error reading the susceptible vector from either default.json OR infectedCell.json\nVerify the format is [[#], [#], ...] and NOT [#, #, ...]"); }
 
-    json.at("vaccinatedD1").get_to(current_sevirds.vaccinatedD1);
-    json.at("vaccinatedD2").get_to(current_sevirds.vaccinatedD2);
+    json.at("vaccinatedD1").get_to(current_sevirds.vaccinatedD1.edit());
+    json.at("vaccinatedD2").get_to(current_sevirds.vaccinatedD2.edit());
 
-    json.at("exposed").get_to(current_sevirds.exposed);
-    json.at("exposedD1").get_to(current_sevirds.exposedD1);
-    json.at("exposedD2").get_to(current_sevirds.exposedD2);
+    json.at("exposed").get_to(current_sevirds.exposed.edit());
+    json.at("exposedD1").get_to(current_sevirds.exposedD1.edit());
+    json.at("exposedD2").get_to(current_sevirds.exposedD2.edit());
 
-    json.at("infected").get_to(current_sevirds.infected);
-    json.at("infectedD1").get_to(current_sevirds.infectedD1);
-    json.at("infectedD2").get_to(current_sevirds.infectedD2);
+    json.at("infected").get_to(current_sevirds.infected.edit());
+    json.at("infectedD1").get_to(current_sevirds.infectedD1.edit());
+    json.at("infectedD2").get_to(current_sevirds.infectedD2.edit());
 
-    json.at("recovered").get_to(current_sevirds.recovered);
-    json.at("recoveredD1").get_to(current_sevirds.recoveredD1);
-    json.at("recoveredD2").get_to(current_sevirds.recoveredD2);
+    json.at("recovered").get_to(current_sevirds.recovered.edit());
+    json.at("recoveredD1").get_to(current_sevirds.recoveredD1.edit());
+    json.at("recoveredD2").get_to(current_sevirds.recoveredD2.edit());
 
-    json.at("fatalities").get_to(current_sevirds.fatalities);
+    json.at("fatalities").get_to(current_sevirds.fatalities.edit());
 
     json.at("disobedient").get_to(current_sevirds.disobedient);
     json.at("hospital_capacity").get_to(current_sevirds.hospital_capacity);
     json.at("fatality_modifier").get_to(current_sevirds.fatality_modifier);
 
-    json.at("immunityD1").get_to(current_sevirds.immunityD1_rate);
-    json.at("immunityD2").get_to(current_sevirds.immunityD2_rate);
+    json.at("immunityD1").get_to(current_sevirds.immunityD1_rate.edit());
+    json.at("immunityD2").get_to(current_sevirds.immunityD2_rate.edit());
     json.at("min_interval_between_doses").get_to(current_sevirds.min_interval_doses);
     json.at("min_interval_between_recovery_and_vaccine").get_to(current_sevirds.min_interval_recovery_to_vaccine);
 
-    current_sevirds.num_age_groups = current_sevirds.age_group_proportions.size();
+    current_sevirds.num_age_groups = current_sevirds.age_group_proportions->size();
     unsigned int age_groups        = current_sevirds.num_age_groups;
 
-    AssertLong(accumulate(current_sevirds.age_group_proportions.begin(), current_sevirds.age_group_proportions.end(), 0.0) == 1,
+    // The proportions in single precision rarely add up to exactly 1
+    double const proportion_tolerance = is_same<proportion, double>::value ? 0.0 : 1e-6;
+
+    AssertLong(accumulate(current_sevirds.age_group_proportions->begin(), current_sevirds.age_group_proportions->end(), 0.0) == 1,
                 __FILE__, __LINE__,
                 "The age group proportions need to add up to 1");
 
     // Checks if the phases have the correct number of age groups
-    AssertLong(age_groups <= current_sevirds.susceptible.size() && age_groups <= current_sevirds.exposed.size() && age_groups <= current_sevirds.infected.size() &&
-                    age_groups <= current_sevirds.recovered.size() && age_groups <= current_sevirds.fatalities.size() && age_groups <= current_sevirds.vaccinatedD1.size() &&
-                    age_groups <= current_sevirds.vaccinatedD2.size() && age_groups <= current_sevirds.immunityD1_rate.size() && age_groups <= current_sevirds.immunityD2_rate.size() &&
-                    age_groups <= current_sevirds.exposedD1.size() && age_groups <= current_sevirds.infectedD2.size() && age_groups <= current_sevirds.recoveredD2.size() &&
-                    age_groups <= current_sevirds.exposedD2.size() && age_groups <= current_sevirds.infectedD2.size() && age_groups <= current_sevirds.recoveredD2.size(),
+    AssertLong(age_groups <= current_sevirds.susceptible->size() && age_groups <= current_sevirds.exposed->size() && age_groups <= current_sevirds.infected->size() &&
+                    age_groups <= current_sevirds.recovered->size() && age_groups <= current_sevirds.fatalities->size() && age_groups <= current_sevirds.vaccinatedD1->size() &&
+                    age_groups <= current_sevirds.vaccinatedD2->size() && age_groups <= current_sevirds.immunityD1_rate->size() && age_groups <= current_sevirds.immunityD2_rate->size() &&
+                    age_groups <= current_sevirds.exposedD1->size() && age_groups <= current_sevirds.infectedD2->size() && age_groups <= current_sevirds.recoveredD2->size() &&
+                    age_groups <= current_sevirds.exposedD2->size() && age_groups <= current_sevirds.infectedD2->size() && age_groups <= current_sevirds.recoveredD2->size(),
                 __FILE__, __LINE__,
                 "There must be at least " + to_string(age_groups) + " age groups for each of the lists under the 'states' parameter in default.json as well as in infectedCell.json");
 
     for (unsigned int a = 0; a < age_groups; ++a)
     {
-        double pop = current_sevirds.susceptible.at(a).front()
-                    + accumulate(current_sevirds.exposed.at(a).begin(),   current_sevirds.exposed.at(a).end(),   0.0)
-                    + accumulate(current_sevirds.infected.at(a).begin(),  current_sevirds.infected.at(a).end(),  0.0)
-                    + accumulate(current_sevirds.recovered.at(a).begin(), current_sevirds.recovered.at(a).end(), 0.0)
-                    + current_sevirds.fatalities.at(a)
-                    + accumulate(current_sevirds.vaccinatedD1.at(a).begin(), current_sevirds.vaccinatedD1.at(a).end(), 0.0)
-                    + accumulate(current_sevirds.vaccinatedD2.at(a).begin(), current_sevirds.vaccinatedD2.at(a).end(), 0.0)
-                    + accumulate(current_sevirds.exposedD1.at(a).begin(),    current_sevirds.exposedD1.at(a).end(),    0.0)
-                    + accumulate(current_sevirds.exposedD2.at(a).begin(),    current_sevirds.exposedD2.at(a).end(),    0.0)
-                    + accumulate(current_sevirds.infectedD1.at(a).begin(),   current_sevirds.infectedD1.at(a).end(),   0.0)
-                    + accumulate(current_sevirds.infectedD2.at(a).begin(),   current_sevirds.infectedD2.at(a).end(),   0.0)
-                    + accumulate(current_sevirds.recoveredD1.at(a).begin(),  current_sevirds.recoveredD1.at(a).end(),  0.0)
-                    + accumulate(current_sevirds.recoveredD2.at(a).begin(),  current_sevirds.recoveredD2.at(a).end(),  0.0);
-
-        AssertLong(pop == 1.0, __FILE__, __LINE__, "The vectors don't add up to 1! " + to_string(pop) + " Double check the values in default.json AND infectedCell.json");
+        double pop = value_of(current_sevirds.susceptible->at(a).front()
+                    + accumulate(current_sevirds.exposed->at(a).begin(),   current_sevirds.exposed->at(a).end(),   scalar{0})
+                    + accumulate(current_sevirds.infected->at(a).begin(),  current_sevirds.infected->at(a).end(),  scalar{0})
+                    + accumulate(current_sevirds.recovered->at(a).begin(), current_sevirds.recovered->at(a).end(), scalar{0})
+                    + current_sevirds.fatalities->at(a)
+                    + accumulate(current_sevirds.vaccinatedD1->at(a).begin(), current_sevirds.vaccinatedD1->at(a).end(), scalar{0})
+                    + accumulate(current_sevirds.vaccinatedD2->at(a).begin(), current_sevirds.vaccinatedD2->at(a).end(), scalar{0})
+                    + accumulate(current_sevirds.exposedD1->at(a).begin(),    current_sevirds.exposedD1->at(a).end(),    scalar{0})
+                    + accumulate(current_sevirds.exposedD2->at(a).begin(),    current_sevirds.exposedD2->at(a).end(),    scalar{0})
+                    + accumulate(current_sevirds.infectedD1->at(a).begin(),   current_sevirds.infectedD1->at(a).end(),   scalar{0})
+                    + accumulate(current_sevirds.infectedD2->at(a).begin(),   current_sevirds.infectedD2->at(a).end(),   scalar{0})
+                    + accumulate(current_sevirds.recoveredD1->at(a).begin(),  current_sevirds.recoveredD1->at(a).end(),  scalar{0})
+                    + accumulate(current_sevirds.recoveredD2->at(a).begin(),  current_sevirds.recoveredD2->at(a).end(),  scalar{0}));
+
+        AssertLong(abs(pop - 1.0) <= proportion_tolerance, __FILE__, __LINE__, "The vectors don't add up to 1! " + to_string(pop) + " Double check the values in default.json AND infectedCell.json");
     }
 
     for (unsigned int i = 0; i < age_groups; ++i)
@@ -520,9 +699,31 @@ void from_json(const nlohmann::json& json, sevirds& current_sevirds)
     }
 
     // Recovered Dose 1 can't be smaller then Susceptible Vaccinated Dose 1
-    AssertLong(current_sevirds.recoveredD1.front().size() >= current_sevirds.vaccinatedD1.front().size(),
+    AssertLong(current_sevirds.recoveredD1->front().size() >= current_sevirds.vaccinatedD1->front().size(),
                 __FILE__, __LINE__,
                 "The recovery phase for those vaccinated with their first dose needs to be smaller then vaccinatedD1!");
 }
 
+/**
+ * @brief Overwrites the modifiers of an already parsed state. Used to
+ * give each member of an ensemble its own modifiers (see ensemble.hpp)
+ *
+ * @param json Any of "disobedient", "hospital_capacity" or "fatality_modifier"
+ * @param current_sevirds Object to modify
+ */
+void patch_modifiers(const nlohmann::json& json, sevirds& current_sevirds)
+{
+    for (auto const& item : json.items())
+    {
+        if (item.key() == "disobedient")
+            item.value().get_to(current_sevirds.disobedient);
+        else if (item.key() == "hospital_capacity")
+            item.value().get_to(current_sevirds.hospital_capacity);
+        else if (item.key() == "fatality_modifier")
+            item.value().get_to(current_sevirds.fatality_modifier);
+        else
+            AssertLong(false, __FILE__, __LINE__, "Unknown state modifier: " + item.key());
+    }
+}
+
 #endif //PANDEMIC_HOYA_2002_SEIRD_HPP
\ No newline at end of file
@@ -6,11 +6,16 @@
 
 #include <nlohmann/json.hpp>
 #include "../Helpers/Assert.hpp"
+#include "../Helpers/Dual.hpp"
 
+// Who may travel out of a cell (config "travel_restriction"), compared as an enum instead of a string on every step
+enum class travel_policy { none, partial, total };
+
+// One instance is shared by all the cells using the same config (see geographical_coupled::shared_config()).
 struct simulation_config
 {
     int prec_divider;
-    using phase_rates = std::vector<std::vector<double>>;
+    using phase_rates = std::vector<std::vector<scalar>>;
 
     phase_rates virulence_rates;
     phase_rates incubation_rates;
@@ -27,9 +32,108 @@ struct simulation_config
     phase_rates vac2_rates;
 
     bool reSusceptibility, is_vaccination;
-    string travel_restriction;
+    string travel_restriction; // "none", "partial" or "total"
+    travel_policy travel = travel_policy::none;
+
+    // The neighbors only read a new state (its summary) once a proportion moved by more than this from the last one they
+    // read; the cell itself keeps every change. Optional, with the default of 0 the neighbors read every change
+    double state_change_tolerance = 0;
+
+    // How the sum over the neighbors of the new exposures is computed. Optional, either
+    // "per_cell" (default, each cell on its own) or "spmv" (all the cells at once, see pressure_engine.hpp)
+    string infection_pressure = "per_cell";
+
+    // CSV file of long-range travel flows between cells (see travel_network.hpp). Optional, none by default
+    string travel_network;
+
+    // Approximation of the travel term by clusters of cells (see far_field.hpp). Optional, read from
+    // "far_field": {"clusters": "<CSV file>", "tolerance": 0, "check": false}. With "check" the exact
+    // sum is also computed to measure the error of the approximation
+    string far_field_clusters;
+    double far_field_tolerance = 0;
+    bool far_field_check       = false;
+
+    // Contacts between the age groups: contact_matrix[a][b] weighs the infectious people of age group b
+    // in the force of infection on the susceptibles of age group a. Optional, without one every age group
+    // infects every other one equally, with the load of each age group also counting the infected of the ones before it
+    phase_rates contact_matrix;
+
+    // How a cell computes the phases of its age groups. Optional, either "age_outer" (default, one age group
+    // after the other) or "age_inner" (every age group at once, one phase after the other, see age_inner_kernel.hpp)
+    string cell_kernel = "age_outer";
+
+    // Whether the transitions move whole people drawn at random instead of proportions (see geographical_cell::transition()).
+    // Each flow, ex: the exposed of day q who become infected, is a binomial draw on the people of the phase with the rate of
+    // the flow as its probability, so a small outbreak can die out. Optional, false by default. Only with the "age_outer" cell_kernel
+    bool stochastic = false;
+
+    // The incubation, recovery and fatality rates with the age group innermost, rates[q * A + a], for the
+    // non-vaccinated then dose 1 and dose 2. Only filled for the "age_inner" cell_kernel
+    struct age_inner_rates
+    {
+        std::vector<scalar> incubation, recovery, fatality;
+    };
+    std::vector<age_inner_rates> age_inner;
+
+    // Parameters whose derivatives the model computes (see sensitivity_log.hpp), ex: ["virulence_rates", "disobedient"].
+    // Either the name of a table of rates of the config, all of its rates together, or "disobedient" or
+    // "fatality_modifier" of the states. Each derivative is with respect to a relative change of the parameter:
+    // d result / d k where the parameter is multiplied by k = 1. Optional, needs a build with SENSITIVITY=<n>
+    std::vector<std::string> sensitivity;
+
+    // Ends the run once the epidemic is over (see epidemic_monitor.hpp). Optional, read from "early_stop": {"below": 1,
+    // "steady_days": 0, "tolerance": 0, "fast_forward": false}. The run stops after the first day with fewer than "below"
+    // people exposed or infected in the whole model, or after "steady_days" days in a row (0: never) where the compartments
+    // of all the cells changed by "tolerance" people or less. With "fast_forward" the cells are then aged to the last day
+    // after an extinction, or keep their states on it after a steady state
+    bool early_stop              = false;
+    double early_stop_below      = 1;
+    unsigned int early_stop_days = 0;
+    double early_stop_tolerance  = 0;
+    bool early_stop_fast_forward = false;
+
+    // JSON file of dated changes of the config and of the states (see timeline.hpp). Optional, none by default
+    string timeline;
+
+    /**
+     * @brief The table of rates read from a config entry
+     *
+     * @param name Name of the entry (ex: "virulence_rates")
+     * @return phase_rates* nullptr if there is no such table
+    */
+    phase_rates* rates_named(std::string const& name)
+    {
+        std::pair<char const*, phase_rates*> const tables[] = {
+            {"virulence_rates", &virulence_rates}, {"incubation_rates", &incubation_rates}, {"recovery_rates", &recovery_rates},
+            {"mobility_rates", &mobility_rates}, {"fatality_rates", &fatality_rates}, {"incubation_rates_dose1", &incubationD1_rates},
+            {"incubation_rates_dose2", &incubationD2_rates}, {"recovery_rates_dose1", &recovery_ratesD1}, {"recovery_rates_dose2", &recovery_ratesD2},
+            {"fatality_rates_dose1", &fatality_ratesD1}, {"fatality_rates_dose2", &fatality_ratesD2}, {"vaccination_rates_dose1", &vac1_rates},
+            {"vaccination_rates_dose2", &vac2_rates}, {"contact_matrix", &contact_matrix}};
+
+        for (auto const& table : tables)
+        {
+            if (name == table.first)
+                return table.second;
+        }
+        return nullptr;
+    }
 };
 
+// rates[a][q] laid out as x[q * A + a]
+inline std::vector<scalar> age_inner_layout(simulation_config::phase_rates const& rates)
+{
+    unsigned int const A = rates.size(), T = rates.at(0).size();
+    std::vector<scalar> x(T * A);
+    for (unsigned int a = 0; a < A; ++a)
+    {
+        Assert::AssertLong(rates.at(a).size() == T, __FILE__, __LINE__, "The \"age_inner\" cell_kernel needs the same phases in every age group");
+        for (unsigned int q = 0; q < T; ++q)
+            x[q * A + a] = rates[a][q];
+    }
+
+    return x;
+}
+
 void from_json(const nlohmann::json& json, simulation_config& v)
 {
     json.at("precision").get_to(v.prec_divider);
@@ -41,6 +145,46 @@ void from_json(const nlohmann::json& json, simulation_config& v)
     json.at("Re-Susceptibility").get_to(v.reSusceptibility);
     json.at("Vaccinations").get_to(v.is_vaccination);
     json.at("travel_restriction").get_to(v.travel_restriction);
+    Assert::AssertLong(v.travel_restriction == "none" || v.travel_restriction == "partial" || v.travel_restriction == "total", __FILE__, __LINE__,
+                        "The travel_restriction must be \"none\", \"partial\" or \"total\", not \"" + v.travel_restriction + "\"");
+    v.travel = v.travel_restriction == "none" ? travel_policy::none : v.travel_restriction == "partial" ? travel_policy::partial : travel_policy::total;
+
+    if (json.contains("state_change_tolerance"))
+        json.at("state_change_tolerance").get_to(v.state_change_tolerance);
+
+    if (json.contains("infection_pressure"))
+        json.at("infection_pressure").get_to(v.infection_pressure);
+    Assert::AssertLong(v.infection_pressure == "per_cell" || v.infection_pressure == "spmv", __FILE__, __LINE__,
+                        "The infection_pressure must be either \"per_cell\" or \"spmv\", not \"" + v.infection_pressure + "\"");
+
+    if (json.contains("travel_network"))
+        json.at("travel_network").get_to(v.travel_network);
+
+    if (json.contains("far_field"))
+    {
+        nlohmann::json const& far_field = json.at("far_field");
+        far_field.at("clusters").get_to(v.far_field_clusters);
+        if (far_field.contains("tolerance"))
+            far_field.at("tolerance").get_to(v.far_field_tolerance);
+        if (far_field.contains("check"))
+            far_field.at("check").get_to(v.far_field_check);
+
+        Assert::AssertLong(!v.travel_network.empty(), __FILE__, __LINE__, "The far_field approximation needs a travel_network");
+        Assert::AssertLong(v.far_field_tolerance >= 0, __FILE__, __LINE__, "The far_field tolerance can't be negative");
+    }
+
+    if (json.contains("contact_matrix"))
+    {
+        json.at("contact_matrix").get_to(v.contact_matrix);
+        Assert::AssertLong(v.contact_matrix.size() == v.virulence_rates.size(), __FILE__, __LINE__,
+                            "The contact_matrix must have a row for each of the " + std::to_string(v.virulence_rates.size()) + " age groups");
+        for (std::vector<scalar> const& row : v.contact_matrix)
+        {
+            Assert::AssertLong(row.size() == v.contact_matrix.size(), __FILE__, __LINE__, "The contact_matrix must be square");
+            for (scalar const& contacts : row)
+                Assert::AssertLong(contacts >= 0, __FILE__, __LINE__, "The contact_matrix can't be negative");
+        }
+    }
 
     try { json.at("vaccination_rates_dose1").get_to(v.vac1_rates); }
     catch(nlohmann::detail::type_error& e) { AssertLong(false, __FILE__, __LINE__, "Error reading the vaccination_rates_dose1 vector from default.json.\nVerify the format is [[#], [#], ...] and NOT [#, #, ...]"); }
@@ -58,12 +202,12 @@ void from_json(const nlohmann::json& json, simulation_config& v)
 
     for (unsigned int i = 0; i < age_groups; ++i)
     {
-        std::vector<double>& v_recovery_rates   = v.recovery_rates.at(i);
-        std::vector<double>& v_recovery_ratesD1 = v.recovery_ratesD1.at(i);
-        std::vector<double>& v_recovery_ratesD2 = v.recovery_ratesD2.at(i);
-        std::vector<double>& v_fatality_rates   = v.fatality_rates.at(i);
-        std::vector<double>& v_fatality_ratesD1 = v.fatality_ratesD1.at(i);
-        std::vector<double>& v_fatality_ratesD2 = v.fatality_ratesD2.at(i);
+        std::vector<scalar>& v_recovery_rates   = v.recovery_rates.at(i);
+        std::vector<scalar>& v_recovery_ratesD1 = v.recovery_ratesD1.at(i);
+        std::vector<scalar>& v_recovery_ratesD2 = v.recovery_ratesD2.at(i);
+        std::vector<scalar>& v_fatality_rates   = v.fatality_rates.at(i);
+        std::vector<scalar>& v_fatality_ratesD1 = v.fatality_ratesD1.at(i);
+        std::vector<scalar>& v_fatality_ratesD2 = v.fatality_ratesD2.at(i);
 
         for (unsigned int k = 0; k < recovery_days; ++k)
         {
@@ -85,6 +229,68 @@ void from_json(const nlohmann::json& json, simulation_config& v)
                             && v.incubationD2_rates.at(i).back() == 1.0,
                             __FILE__, __LINE__, "The last day in the incubation rates must be 1 since everyone exposed moves to infected at the end of the exposed phase");
     }
+
+    if (json.contains("sensitivity"))
+        json.at("sensitivity").get_to(v.sensitivity);
+    Assert::AssertLong(v.sensitivity.size() <= num_derivatives, __FILE__, __LINE__,
+                        "The sensitivity to " + std::to_string(v.sensitivity.size()) + " parameters needs a build with SENSITIVITY="
+                        + std::to_string(v.sensitivity.size()) + " or more");
+    Assert::AssertLong(v.sensitivity.empty() || (v.infection_pressure == "per_cell" && v.travel_network.empty()),
+                        __FILE__, __LINE__, "The sensitivity can't be computed with \"spmv\" or a travel_network");
+
+    // Every rate of a table has a derivative of itself with respect to k, the factor of the whole table
+    for (unsigned int i = 0; i < v.sensitivity.size(); ++i)
+    {
+        std::string const& parameter = v.sensitivity.at(i);
+        if (parameter == "disobedient" || parameter == "fatality_modifier")
+            continue; // Set in the states (see sevirds::seed_sensitivity())
+
+        simulation_config::phase_rates* rates = v.rates_named(parameter);
+        Assert::AssertLong(rates && !rates->empty(), __FILE__, __LINE__, "There is no " + parameter + " to compute the sensitivity to");
+        for (std::vector<scalar>& row : *rates)
+        {
+            for (scalar& rate : row)
+                set_derivative(rate, i, value_of(rate));
+        }
+    }
+
+    if (json.contains("cell_kernel"))
+        json.at("cell_kernel").get_to(v.cell_kernel);
+    Assert::AssertLong(v.cell_kernel == "age_outer" || v.cell_kernel == "age_inner", __FILE__, __LINE__,
+                        "The cell_kernel must be either \"age_outer\" or \"age_inner\", not \"" + v.cell_kernel + "\"");
+
+    if (json.contains("stochastic"))
+        json.at("stochastic").get_to(v.stochastic);
+    Assert::AssertLong(!v.stochastic || (v.cell_kernel == "age_outer" && v.sensitivity.empty()), __FILE__, __LINE__,
+                        "The stochastic transitions need the \"age_outer\" cell_kernel and no sensitivity");
+
+    if (json.contains("early_stop"))
+    {
+        nlohmann::json const& early_stop = json.at("early_stop");
+        v.early_stop = true;
+        if (early_stop.contains("below"))
+            early_stop.at("below").get_to(v.early_stop_below);
+        if (early_stop.contains("steady_days"))
+            early_stop.at("steady_days").get_to(v.early_stop_days);
+        if (early_stop.contains("tolerance"))
+            early_stop.at("tolerance").get_to(v.early_stop_tolerance);
+        if (early_stop.contains("fast_forward"))
+            early_stop.at("fast_forward").get_to(v.early_stop_fast_forward);
+
+        Assert::AssertLong(v.early_stop_below >= 0 && v.early_stop_tolerance >= 0, __FILE__, __LINE__,
+                            "The early_stop below and tolerance can't be negative");
+    }
+
+    if (json.contains("timeline"))
+        json.at("timeline").get_to(v.timeline);
+    Assert::AssertLong(v.timeline.empty() || v.sensitivity.empty(), __FILE__, __LINE__, "The sensitivity can't be computed with a timeline");
+
+    if (v.cell_kernel == "age_inner")
+    {
+        v.age_inner.push_back({age_inner_layout(v.incubation_rates), age_inner_layout(v.recovery_rates), age_inner_layout(v.fatality_rates)});
+        v.age_inner.push_back({age_inner_layout(v.incubationD1_rates), age_inner_layout(v.recovery_ratesD1), age_inner_layout(v.fatality_ratesD1)});
+        v.age_inner.push_back({age_inner_layout(v.incubationD2_rates), age_inner_layout(v.recovery_ratesD2), age_inner_layout(v.fatality_ratesD2)});
+    }
 }
 
 #endif //PANDEMIC_HOYA_2002_SIMULATION_CONFIG_HPP
\ No newline at end of file
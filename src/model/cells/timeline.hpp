@@ -0,0 +1,142 @@
+#ifndef PANDEMIC_HOYA_2002_TIMELINE_HPP
+#define PANDEMIC_HOYA_2002_TIMELINE_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "simulation_config.hpp"
+#include "../Helpers/Assert.hpp"
+
+using namespace std;
+
+/**
+ * Dated changes of the config and of the states during a run (config "timeline": "<JSON file>"), so a study
+ * with several stages (ex: a lockdown from day 60 to day 120) is a single run:
+ *  {
+ *      "events": [
+ *          {"day": 60, "config": {"travel_restriction": "total"}, "state": {"disobedient": 0.05}},
+ *          {"day": 90, "state": {"hospital_capacity": 0.2}, "cells": ["ontario_3530"]},
+ *          {"day": 120, "config": {"travel_restriction": "none"}}
+ *      ]
+ *  }
+ *
+ * The changes of the config add up from one event to the next, and each stage is parsed once, here, into a config
+ * that the cells switch to on its day. The "state" of an event replaces the modifiers of the states (see patch_modifiers())
+ * of the listed "cells", or of every cell without a list, in the states computed on its day, which the cells and their
+ * neighbors use from the next day on. The keys that shape the model (the precision, the vaccinations,
+ * how the pressure, the travel and the kernel are computed...) can't change during a run.
+*/
+class timeline
+{
+    public:
+        // A config in effect from a day on
+        struct stage
+        {
+            double day;
+            shared_ptr<simulation_config const> config;
+        };
+
+        // Modifiers given to the states of some cells on a day
+        struct state_change
+        {
+            double day;
+            nlohmann::json modifiers;
+            unordered_set<string> cells; // Every cell if empty
+
+            bool applies_to(string const& cell_id) const { return cells.empty() || cells.count(cell_id) > 0; }
+        };
+
+        /**
+         * @brief Reads the events of a timeline and parses the config of each of its stages
+         *
+         * @param file_path Path of the timeline file
+         * @param config Unparsed config the timeline starts from
+         * @param parsed The same config, parsed
+        */
+        timeline(string const& file_path, nlohmann::json const& config, shared_ptr<simulation_config const> parsed)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            nlohmann::json json;
+            file >> json;
+
+            vector<nlohmann::json> events = json.at("events");
+            stable_sort(events.begin(), events.end(), [](nlohmann::json const& a, nlohmann::json const& b)
+                        { return a.at("day").get<double>() < b.at("day").get<double>(); });
+
+            stages.push_back({0, move(parsed)});
+            nlohmann::json staged = config;
+
+            for (nlohmann::json const& event : events)
+            {
+                double const day = event.at("day").get<double>();
+                AssertLong(day >= 0, __FILE__, __LINE__, "The day of an event of " + file_path + " can't be negative");
+                last = max(last, day);
+
+                if (event.contains("config"))
+                {
+                    check_changes(event.at("config"), file_path);
+                    staged.merge_patch(event.at("config"));
+                    auto next = make_shared<simulation_config const>(staged.get<simulation_config>());
+
+                    if (stages.size() > 1 && stages.back().day == day)
+                        stages.back().config = move(next);
+                    else
+                        stages.push_back({day, move(next)});
+                }
+
+                if (event.contains("state"))
+                {
+                    state_change change{day, event.at("state"), {}};
+                    if (event.contains("cells"))
+                        change.cells = event.at("cells").get<unordered_set<string>>();
+                    changes.push_back(move(change));
+                }
+            }
+        }
+
+        vector<stage> const& get_stages() const { return stages; }
+        vector<state_change> const& get_changes() const { return changes; }
+
+        // Day of the last event
+        double last_day() const { return last; }
+
+        /**
+         * @brief Checks that changes of a config leave the keys that shape the model alone
+         *
+         * @param config_changes Changes merged over a config during a run
+         * @param source Where they come from, for the error message
+        */
+        static void check_changes(nlohmann::json const& config_changes, string const& source)
+        {
+            for (auto const& item : config_changes.items())
+            {
+                AssertLong(find(begin(fixed_keys), end(fixed_keys), item.key()) == end(fixed_keys), __FILE__, __LINE__,
+                            "The " + item.key() + " of the config can't change during a run (" + source + ")");
+            }
+        }
+
+        // Config in effect on a day
+        shared_ptr<simulation_config const> const& config_at(double day) const
+        {
+            auto after = upper_bound(stages.begin() + 1, stages.end(), day, [](double d, stage const& s) { return d < s.day; });
+            return prev(after)->config;
+        }
+
+    private:
+        // Keys of the config the cells and the pressure_engine are built from
+        static constexpr char const* fixed_keys[] = {"precision", "Vaccinations", "infection_pressure", "travel_network", "far_field",
+                                                     "cell_kernel", "sensitivity", "stochastic", "early_stop", "timeline"};
+
+        vector<stage> stages; // By day, starting with the config of the scenario on day 0
+        vector<state_change> changes; // By day
+        double last = 0;
+};
+
+#endif //PANDEMIC_HOYA_2002_TIMELINE_HPP
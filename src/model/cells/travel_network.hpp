@@ -0,0 +1,120 @@
+#ifndef PANDEMIC_HOYA_2002_TRAVEL_NETWORK_HPP
+#define PANDEMIC_HOYA_2002_TRAVEL_NETWORK_HPP
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Helpers/Assert.hpp"
+
+using namespace std;
+
+/**
+ * Long-range travel (ex: air travel) between cells that aren't necessarily neighbors. It's read from
+ * a CSV file with one flow per line:
+ *
+ *     origin,destination,correlation
+ *
+ * where the correlation plays the part of cij for the people of the origin reaching the destination.
+ * A flow only goes one way, both directions must be listed for a symmetric one. The first line is
+ * skipped when it's the header above.
+ *
+ * The flows are kept apart from the neighborhoods of the cells: once resolve() is called they are stored
+ * by destination in CSR form (flows_begin, origins and correlations), so hundreds of thousands of them
+ * cost a few bytes each instead of a vicinity in the neighbor maps of the cells.
+*/
+class travel_network
+{
+    public:
+        // Flows into the cell of row i are flows_begin[i] to flows_begin[i + 1] - 1
+        vector<unsigned int> flows_begin{0};
+        vector<unsigned int> origins;
+        vector<double> correlations;
+
+        travel_network() = default;
+
+        explicit travel_network(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            string line;
+            unsigned int line_number = 0;
+            while (getline(file, line))
+            {
+                ++line_number;
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || (line_number == 1 && line == "origin,destination,correlation"))
+                    continue;
+
+                stringstream columns{line};
+                string origin, destination, correlation;
+                getline(columns, origin, ',');
+                getline(columns, destination, ',');
+                getline(columns, correlation, ',');
+
+                Assert::AssertLong(!origin.empty() && !destination.empty() && !correlation.empty(), __FILE__, __LINE__,
+                                    "Line " + to_string(line_number) + " of " + file_path + " must be origin,destination,correlation");
+
+                staged.push_back({move(origin), move(destination), stod(correlation)});
+            }
+        }
+
+        bool empty() const { return staged.empty() && origins.empty(); }
+
+        /**
+         * @brief Replaces the ids of the cells by their rows and sorts the flows by destination
+         *
+         * @param num_rows Number of cells
+         * @param row_ids Row of each cell
+        */
+        void resolve(unsigned int num_rows, unordered_map<string, unsigned int> const& row_ids)
+        {
+            auto row_of = [&row_ids](string const& id)
+            {
+                auto found = row_ids.find(id);
+                Assert::AssertLong(found != row_ids.end(), __FILE__, __LINE__, "The cell " + id + " of the travel network isn't a cell of the model");
+                return found->second;
+            };
+
+            // Counting sort by destination
+            vector<unsigned int> destinations;
+            destinations.reserve(staged.size());
+            flows_begin.assign(num_rows + 1, 0);
+            for (staged_flow const& flow : staged)
+            {
+                destinations.push_back(row_of(flow.destination));
+                ++flows_begin.at(destinations.back() + 1);
+            }
+
+            for (unsigned int i = 0; i < num_rows; ++i)
+                flows_begin.at(i + 1) += flows_begin.at(i);
+
+            origins.assign(staged.size(), 0);
+            correlations.assign(staged.size(), 0.0);
+            vector<unsigned int> next(flows_begin.begin(), flows_begin.end() - 1);
+            for (unsigned int f = 0; f < staged.size(); ++f)
+            {
+                unsigned int const e = next.at(destinations.at(f))++;
+                origins.at(e)      = row_of(staged.at(f).origin);
+                correlations.at(e) = staged.at(f).correlation;
+            }
+
+            staged.clear();
+            staged.shrink_to_fit();
+        }
+
+    private:
+        // The flows as read, until the rows of the cells are known
+        struct staged_flow
+        {
+            string origin, destination;
+            double correlation;
+        };
+        vector<staged_flow> staged;
+};
+
+#endif //PANDEMIC_HOYA_2002_TRAVEL_NETWORK_HPP
@@ -5,8 +5,10 @@
 
 #include <functional>
 #include <cmath>
+#include <map>
 #include <nlohmann/json.hpp>
 #include "hysteresis_factor.hpp"
+#include "../Helpers/Assert.hpp"
 
 using namespace std;
 
@@ -75,4 +77,60 @@ void from_json(const nlohmann::json& json, vicinity& vicinity)
     }
 } //from_json()
 
+/**
+ * @brief Correction factor of the movement between two cells given the infections of the
+ * neighbor and the hysteresis left by the previous days, which it updates
+ *
+ * @param mobility_correction_factors Correction factors of the vicinity between the two cells
+ * @param infectious_population Total infections of the neighbor
+ * @param hysteresisFactor Hysteresis of that vicinity
+ * @return double
+*/
+inline double movement_correction_factor(const map<vicinity::infection_threshold, vicinity::mobility_correction_factor>& mobility_correction_factors,
+                                         double infectious_population, hysteresis_factor& hysteresisFactor)
+{
+    // For example, assume a correction factor of "0.4": [0.2, 0.1]. If the infection goes above 0.4, then the
+    // correction factor of 0.2 will now be applied to total infection values above 0.3, no longer 0.4 as the
+    // hysteresis is in effect.
+    if (infectious_population > hysteresisFactor.infections_higher_bound)
+        hysteresisFactor.in_effect = false;
+
+    // This is uses the comparison '>', not '>=' ; otherwise if the lower bound is 0 there is no way for the hysteresis
+    // to disappear as the infections can never go below 0
+    if (hysteresisFactor.in_effect && infectious_population > hysteresisFactor.infections_lower_bound)
+        return hysteresisFactor.mobility_correction_factor;
+
+    hysteresisFactor.in_effect = false;
+
+    double correction = 1.0;
+    for (auto const& pair: mobility_correction_factors)
+    {
+        if (infectious_population >= pair.first)
+        {
+            correction = pair.second.front();
+
+            // A hysteresis factor will be in effect until the total infection goes below the hysteresis factor;
+            // until that happens the information required to return a movement factor must be kept in above variables.
+
+            // Get the threshold of the next correction factor; otherwise the current correction factor can remain in
+            // effect if the total infections never goes below the lower bound hysteresis factor, but also if it goes
+            // above the original total infection threshold!
+            auto next_pair_iterator = find(mobility_correction_factors.begin(), mobility_correction_factors.end(), pair);
+            Assert::AssertLong(next_pair_iterator != mobility_correction_factors.end(), __FILE__, __LINE__);
+
+            // If there is a next correction factor (for a higher total infection), then use it's total infection threshold
+            if ((long unsigned int) distance(mobility_correction_factors.begin(), next_pair_iterator) != mobility_correction_factors.size() - 1)
+                ++next_pair_iterator;
+
+            hysteresisFactor.in_effect                  = true;
+            hysteresisFactor.infections_higher_bound    = next_pair_iterator->first;
+            hysteresisFactor.infections_lower_bound     = pair.first - pair.second.back();
+            hysteresisFactor.mobility_correction_factor = pair.second.front();
+        } else
+            break;
+    }
+
+    return correction;
+} //movement_correction_factor()
+
 #endif //CELL_DEVS_ZHONG_DEVEL_VICINITY_H
\ No newline at end of file
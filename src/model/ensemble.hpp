@@ -0,0 +1,181 @@
+#ifndef PANDEMIC_HOYA_2002_ENSEMBLE_HPP
+#define PANDEMIC_HOYA_2002_ENSEMBLE_HPP
+
+#include <fstream>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Helpers/Assert.hpp"
+#include "Helpers/Parallel.hpp"
+
+using namespace std;
+
+/**
+ * One simulation of an ensemble. The config and state are merged
+ * over those of the scenario (see geographical_coupled::add_cells())
+*/
+struct ensemble_member
+{
+    string id;
+    unsigned int seed = 1;
+    nlohmann::json config = nlohmann::json::object();
+    nlohmann::json state  = nlohmann::json::object();
+};
+
+/**
+ * Reads an ensemble file and runs its members on a pool of threads.
+ * The file looks like this (every entry is optional):
+ *  {
+ *      "threads": 8,
+ *      "log_messages": false,
+ *      "members": [ {"id": "lockdown", "config": {"travel_restriction": "total"}, "state": {"disobedient": 0.05}} ],
+ *      "grid": { "config": {"travel_restriction": ["none", "partial"]}, "state": {"disobedient": [0.1, 0.3]} },
+ *      "seeds": [1, 2, 3]
+ *  }
+ * Every member is combined with every point of the grid and then with every seed,
+ * so the above runs 1 x 4 x 3 = 12 simulations.
+*/
+class ensemble
+{
+    public:
+        vector<ensemble_member> members;
+        unsigned int threads = 0; // 0 uses every hardware thread
+        bool log_messages    = false;
+
+        explicit ensemble(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            nlohmann::json json;
+            file >> json;
+
+            if (json.contains("threads"))
+                json.at("threads").get_to(threads);
+            if (json.contains("log_messages"))
+                json.at("log_messages").get_to(log_messages);
+
+            if (json.contains("members"))
+            {
+                for (nlohmann::json const& member_json : json.at("members"))
+                {
+                    ensemble_member member;
+                    if (member_json.contains("id"))     member.id = value_name(member_json.at("id"));
+                    if (member_json.contains("seed"))   member_json.at("seed").get_to(member.seed);
+                    if (member_json.contains("config")) member.config = member_json.at("config");
+                    if (member_json.contains("state"))  member.state  = member_json.at("state");
+                    members.push_back(move(member));
+                }
+            }
+            else
+                members.push_back(ensemble_member{});
+
+            if (json.contains("grid"))
+                expand_grid(json.at("grid"));
+
+            if (json.contains("seeds"))
+                expand_seeds(json.at("seeds").get<vector<unsigned int>>());
+
+            for (unsigned int i = 0; i < members.size(); ++i)
+            {
+                if (members.at(i).id.empty())
+                    members.at(i).id = "member" + to_string(i);
+            }
+
+            // Every member writes its logs under its id
+            set<string> ids;
+            for (ensemble_member const& member : members)
+                AssertLong(ids.insert(member.id).second, __FILE__, __LINE__, "The ensemble " + file_path + " has two members named " + member.id);
+
+            AssertLong(!members.empty(), __FILE__, __LINE__, "The ensemble " + file_path + " has no members");
+        }
+
+        /**
+         * @brief Runs every member, several at a time
+         *
+         * @param run_member Runs a single simulation. Called from the worker threads
+        */
+        void run(function<void(ensemble_member const&)> const& run_member) const
+        {
+            Parallel::for_each_index(members.size(), threads, [&](size_t i) { run_member(members.at(i)); });
+        }
+
+    private:
+        /**
+         * @brief Replaces the members by their combination with every point of the grid.
+         * The grid is {"config": {key: [values...]}, "state": {key: [values...]}}
+        */
+        void expand_grid(nlohmann::json const& grid)
+        {
+            // Flatten the grid into a list of axes
+            struct axis { string section; string key; nlohmann::json values; };
+            vector<axis> axes;
+            for (string const section : {"config", "state"})
+            {
+                if (!grid.contains(section))
+                    continue;
+
+                for (auto const& item : grid.at(section).items())
+                {
+                    AssertLong(item.value().is_array() && !item.value().empty(), __FILE__, __LINE__,
+                                "The grid values of " + item.key() + " must be a non-empty list");
+                    axes.push_back({section, item.key(), item.value()});
+                }
+            }
+
+            for (axis const& a : axes)
+            {
+                vector<ensemble_member> expanded;
+                expanded.reserve(members.size() * a.values.size());
+
+                for (ensemble_member const& member : members)
+                {
+                    for (unsigned int v = 0; v < a.values.size(); ++v)
+                    {
+                        ensemble_member point = member;
+                        (a.section == "config" ? point.config : point.state)[a.key] = a.values.at(v);
+                        point.id += (point.id.empty() ? "" : "_") + value_name(a.key) + "-" + value_name(a.values.at(v));
+                        expanded.push_back(move(point));
+                    }
+                }
+
+                members = move(expanded);
+            }
+        }
+
+        void expand_seeds(vector<unsigned int> const& seeds)
+        {
+            vector<ensemble_member> expanded;
+            expanded.reserve(members.size() * seeds.size());
+
+            for (ensemble_member const& member : members)
+            {
+                for (unsigned int seed : seeds)
+                {
+                    ensemble_member replica = member;
+                    replica.seed = seed;
+                    replica.id  += (replica.id.empty() ? "" : "_") + string{"seed"} + to_string(seed);
+                    expanded.push_back(move(replica));
+                }
+            }
+
+            members = move(expanded);
+        }
+
+        // Makes an id or a grid value usable in a file name, which can't reach outside of the logs folder
+        static string value_name(nlohmann::json const& value)
+        {
+            string name = value.is_string() ? value.get<string>() : value.dump();
+            for (char& c : name)
+            {
+                if (!isalnum(c) && c != '.' && c != '-')
+                    c = '_';
+            }
+            return name;
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_ENSEMBLE_HPP
@@ -7,6 +7,7 @@
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/coupled/cells_coupled.hpp>
 #include "cells/geographical_cell.hpp"
+#include "scenario.hpp"
 
 using namespace std;
 
@@ -25,11 +26,283 @@ class geographical_coupled : public cadmium::celldevs::cells_coupled<T, string,
                             string const& delay_id,
                             nlohmann::json const& config) override
         {
-            if (cell_type == "zhong")
+            add_zhong_cell(cell_type, cell_id, neighborhood, move(initial_state), delay_id, shared_config(config));
+        }
+
+        /**
+         * @brief Adds every cell of an already parsed scenario. Unlike add_cells_json()
+         * the scenario file isn't read again, so many models can be built from one file
+         *
+         * @param scenario Parsed scenario file
+         * @param config_overrides Merged over the config of every cell (ex: {"travel_restriction": "total"})
+         * @param state_overrides Modifiers replaced in every initial state (ex: {"disobedient": 0.2})
+        */
+        void add_cells(scenario const& scenario, nlohmann::json const& config_overrides = nlohmann::json::object(),
+                        nlohmann::json const& state_overrides = nlohmann::json::object())
+        {
+            add_cells(scenario, vector<nlohmann::json>(scenario.configs.size(), config_overrides), state_overrides);
+        }
+
+        /**
+         * @brief Adds every cell of an already parsed scenario, with overrides of its own for each config of the scenario
+         *
+         * @param scenario Parsed scenario file
+         * @param config_overrides Merged over each config of scenario.configs, in the same order
+         * @param state_overrides Modifiers replaced in every initial state (ex: {"disobedient": 0.2})
+        */
+        void add_cells(scenario const& scenario, vector<nlohmann::json> const& config_overrides, nlohmann::json const& state_overrides)
+        {
+            AssertLong(config_overrides.size() == scenario.configs.size(), __FILE__, __LINE__, "There must be overrides for every config of the scenario");
+
+            // Each distinct config is parsed once, here, instead of once per cell
+            vector<shared_ptr<config_type const>> configs;
+            for (unsigned int i = 0; i < scenario.configs.size(); ++i)
             {
-                auto conf = config.get<typename geographical_cell<T>::config_type>();
-                this->template add_cell<geographical_cell>(cell_id, neighborhood, initial_state, delay_id, conf);
-            } else throw bad_typeid();
+                nlohmann::json config = scenario.configs.at(i);
+                config.merge_patch(config_overrides.at(i));
+                configs.push_back(shared_config(config));
+            }
+
+            for (scenario_cell const& cell : scenario.cells)
+            {
+                sevirds initial_state = cell.state;
+                patch_modifiers(state_overrides, initial_state);
+
+                add_zhong_cell(cell.cell_type, cell.cell_id, cell.neighborhood, move(initial_state),
+                                cell.delay_id, configs.at(cell.config_index));
+            }
+        }
+
+        /**
+         * @brief Makes the cells added from now on report their state to a region_series, if their region is one of its regions
+         *
+         * @param series Totals of the observed regions (see calibration.hpp)
+        */
+        void observe_regions(shared_ptr<region_series> series)
+        {
+            observed_series = move(series);
+        }
+
+        /**
+         * @brief Prints what the far_field approximation of the travel did (see far_field.hpp), if the model used one
+         *
+         * @param out Where to print it
+        */
+        void print_far_field_report(ostream& out) const
+        {
+            far_field::report_type const* report = shared_engine ? shared_engine->far_field_report() : nullptr;
+            if (!report)
+                return;
+
+            out << "Far field: " << report->terms << " terms summed instead of " << report->flows << " flows for "
+                << report->evaluations << " travel pressures, error bound " << report->max_bound;
+            if (report->checked)
+                out << ", largest error against the exact sum " << report->max_error;
+            out << endl;
+        }
+
+        /**
+         * @brief Writes the daily totals and their derivatives (see sensitivity_log.hpp), if the config asked for them
+         *
+         * @param file_path Path of the CSV file
+        */
+        void write_sensitivity(string const& file_path) const
+        {
+            if (shared_sensitivity)
+                shared_sensitivity->write(file_path);
+        }
+
+        // Tells when the epidemic is over (see epidemic_monitor.hpp), nullptr unless the config has an early_stop
+        shared_ptr<epidemic_monitor> const& monitor() const { return shared_monitor; }
+
+        /**
+         * @brief Ages every cell to the last day of a run that stopped early, if the config's early_stop asks for it
+         * (see geographical_cell::aged()), and writes their states at that time as the state logger would.
+         * After a steady state the epidemic may still go on, so the cells keep the states they stopped with
+         * instead of ageing without any infection pressure
+         *
+         * @param stop Day the run stopped after
+         * @param last Last day of the full run
+         * @param steady Whether the run stopped for the steady state rather than the extinction (see epidemic_monitor::steady())
+         * @param state_log Where the state logger writes
+        */
+        void fast_forward(unsigned int stop, unsigned int last, bool steady, ostream& state_log) const
+        {
+            if (!fast_forward_cells || last <= stop)
+                return;
+
+            state_log << last << endl;
+            for (shared_ptr<geographical_cell<T>> const& cell : get_cells())
+                state_log << "State for model _" << cell->cell_id << " is " << cell->aged(steady ? 0 : last - stop) << endl;
+        }
+
+        // The cells added so far, in the order they were added
+        vector<shared_ptr<geographical_cell<T>>> get_cells() const
+        {
+            vector<shared_ptr<geographical_cell<T>>> cells;
+            for (auto const& model : this->_models)
+            {
+                auto cell = dynamic_pointer_cast<geographical_cell<T>>(model);
+                if (cell)
+                    cells.push_back(move(cell));
+            }
+            return cells;
+        }
+
+        /**
+         * @brief Changes the configs and the modifiers of the states between two days of a run, as an event of a
+         * timeline on the day the run goes on from would (see timeline.hpp). The models with a timeline can't be changed this way
+         *
+         * @param config_changes Merged over every config of the model (ex: {"travel_restriction": "total"})
+         * @param modifiers Modifiers given to the next states (ex: {"disobedient": 0.2})
+         * @param cells Cells whose states change, every cell if empty
+        */
+        void modify(nlohmann::json const& config_changes, nlohmann::json const& modifiers, unordered_set<string> const& cells)
+        {
+            for (parsed_config const& parsed : parsed_configs)
+                AssertLong(!parsed.events, __FILE__, __LINE__, "A model with a timeline can't be modified during its run");
+
+            vector<shared_ptr<geographical_cell<T>>> const all_cells = get_cells();
+
+            if (!config_changes.empty())
+            {
+                timeline::check_changes(config_changes, "modify()");
+
+                vector<pair<shared_ptr<config_type const>, shared_ptr<config_type const>>> replaced;
+                for (parsed_config& parsed : parsed_configs)
+                {
+                    parsed.json.merge_patch(config_changes);
+                    replaced.emplace_back(parsed.config, make_shared<config_type const>(parsed.json.template get<config_type>()));
+                    parsed.config = replaced.back().second;
+                }
+
+                auto next = [&](shared_ptr<config_type const> const& config)
+                {
+                    return find_if(replaced.begin(), replaced.end(), [&](auto const& r) { return r.first == config; })->second;
+                };
+
+                for (shared_ptr<geographical_cell<T>> const& cell : all_cells)
+                    cell->take_config(next(cell->memory.config));
+                if (shared_engine)
+                    shared_engine->take_config(next(shared_engine->get_config()));
+            }
+
+            if (!modifiers.empty())
+            {
+                for (shared_ptr<geographical_cell<T>> const& cell : all_cells)
+                {
+                    if (cells.empty() || cells.count(cell->cell_id) > 0)
+                        cell->modify_state(modifiers);
+                }
+            }
+        }
+
+    private:
+        using config_type = typename geographical_cell<T>::config_type;
+
+        void add_zhong_cell(string const& cell_type, string const& cell_id,
+                            cell_unordered<vicinity> const& neighborhood,
+                            sevirds initial_state,
+                            string const& delay_id,
+                            shared_ptr<config_type const> const& config)
+        {
+            if (cell_type != "zhong")
+                throw bad_typeid();
+
+            shared_ptr<timeline const> const& events = timeline_of(config);
+
+            shared_ptr<pressure_engine<T>> engine;
+            if (config->infection_pressure == "spmv" || !config->travel_network.empty())
+            {
+                if (!shared_engine)
+                {
+                    shared_engine = make_shared<pressure_engine<T>>(config);
+                    shared_engine->follow(events);
+                }
+                engine = shared_engine;
+            }
+
+            if (!config->sensitivity.empty())
+            {
+                if (!shared_sensitivity)
+                    shared_sensitivity = make_shared<sensitivity_log>(config->sensitivity);
+                AssertLong(shared_sensitivity->parameter_names() == config->sensitivity, __FILE__, __LINE__,
+                            "Every cell must compute the sensitivity to the same parameters");
+            }
+
+            if (config->early_stop)
+            {
+                if (!shared_monitor)
+                {
+                    shared_monitor = make_shared<epidemic_monitor>(config->early_stop_below, config->early_stop_days, config->early_stop_tolerance);
+                    fast_forward_cells = config->early_stop_fast_forward;
+                }
+            }
+            AssertLong(config->early_stop == (bool)shared_monitor, __FILE__, __LINE__, "Either every cell or none must have an early_stop");
+
+            this->template add_cell<geographical_cell>(cell_id, neighborhood, initial_state, delay_id, config, engine, shared_sensitivity,
+                                                        observed_series, shared_monitor, events);
+        }
+
+        // Computes the infection pressure of all the cells at once, and their long-range travel, when the config asks for it
+        shared_ptr<pressure_engine<T>> shared_engine;
+
+        // Totals and derivatives every cell reports to, when the config has a sensitivity
+        shared_ptr<sensitivity_log> shared_sensitivity;
+
+        // Totals of the observed regions, which the cells of those regions report to (see observe_regions())
+        shared_ptr<region_series> observed_series;
+
+        // Tells when the epidemic is over, when the config has an early_stop. Every cell reports to it
+        shared_ptr<epidemic_monitor> shared_monitor;
+        bool fast_forward_cells = false;
+
+        // A config as it was read, parsed, and the stages of its timeline if it has one (see timeline.hpp)
+        struct parsed_config
+        {
+            nlohmann::json json;
+            shared_ptr<config_type const> config;
+            shared_ptr<timeline const> events;
+        };
+
+        // Every distinct config parsed so far. There is usually only one so a list is enough
+        vector<parsed_config> parsed_configs;
+
+        /**
+         * @brief Parses a config the first time it's seen and afterwards returns the same
+         * read-only instance, which all the cells with that config share. So is its timeline
+         *
+         * @param config Unparsed config of a cell
+         * @return shared_ptr<config_type const>
+        */
+        shared_ptr<config_type const> shared_config(nlohmann::json const& config)
+        {
+            for (parsed_config const& parsed : parsed_configs)
+            {
+                if (parsed.json == config)
+                    return parsed.config;
+            }
+
+            auto parsed = make_shared<config_type const>(config.get<config_type>());
+            shared_ptr<timeline const> events;
+            if (!parsed->timeline.empty())
+                events = make_shared<timeline const>(parsed->timeline, config, parsed);
+
+            parsed_configs.push_back({config, parsed, events});
+            return parsed;
+        }
+
+        // The timeline of a parsed config, nullptr if it has none
+        shared_ptr<timeline const> const& timeline_of(shared_ptr<config_type const> const& config) const
+        {
+            for (parsed_config const& parsed : parsed_configs)
+            {
+                if (parsed.config == config)
+                    return parsed.events;
+            }
+
+            static shared_ptr<timeline const> const none;
+            return none;
         }
 };
 
@@ -0,0 +1,296 @@
+#ifndef PANDEMIC_HOYA_2002_SCENARIO_HPP
+#define PANDEMIC_HOYA_2002_SCENARIO_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "cells/sevirds.hpp"
+#include "cells/vicinity.hpp"
+#include "Helpers/Assert.hpp"
+
+using namespace std;
+
+/**
+ * A cell of the scenario with its 'default' entry already merged in
+ * and its state and neighborhood already parsed
+*/
+struct scenario_cell
+{
+    string cell_id;
+    string cell_type;
+    string delay_id;
+    unordered_map<string, vicinity> neighborhood;
+    sevirds state;
+    unsigned int config_index; // Index into scenario::configs
+};
+
+/**
+ * Holds a parsed scenario json (see generateScenario.py) so that it can be
+ * used to build any number of geographical_coupled models without reading
+ * or parsing the file again. Nothing in here is modified once loaded, so one
+ * scenario can be shared by simulations running on different threads.
+*/
+class scenario
+{
+    public:
+        vector<scenario_cell> cells;
+
+        // Every distinct "config" found in the scenario. Most scenarios only have one
+        // (the one under "default") so the cells only keep an index into this list.
+        vector<nlohmann::json> configs;
+
+        scenario() = default;
+
+        explicit scenario(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            nlohmann::json json;
+            file >> json;
+            load(json);
+        }
+
+        /**
+         * @brief Parses the "cells" object of a scenario. Each cell is patched over
+         * the "default" cell, except for its neighborhood which replaces the default one
+         *
+         * @param json Contents of the scenario file
+        */
+        void load(nlohmann::json const& json)
+        {
+            nlohmann::json const& json_cells = json.at("cells");
+            nlohmann::json default_cell      = json_cells.contains("default") ? json_cells.at("default") : nlohmann::json::object();
+
+            cells.clear();
+            configs.clear();
+            cells.reserve(json_cells.size());
+
+            for (auto const& item : json_cells.items())
+            {
+                if (item.key() == "default")
+                    continue;
+
+                nlohmann::json cell_json = default_cell;
+                cell_json.merge_patch(item.value());
+
+                AssertLong(item.value().contains("neighborhood"), __FILE__, __LINE__, "The cell " + item.key() + " has no neighborhood");
+
+                scenario_cell cell;
+                cell.cell_id      = item.key();
+                cell.cell_type    = cell_json.at("cell_type").get<string>();
+                cell.delay_id     = cell_json.at("delay").get<string>();
+                cell.neighborhood = item.value().at("neighborhood").get<unordered_map<string, vicinity>>();
+                cell.state        = cell_json.at("state").get<sevirds>();
+                cell.config_index = config_index(cell_json.at("config"));
+
+                cells.push_back(move(cell));
+            }
+        }
+
+        /**
+         * @brief Builds the scenario straight from an input directory and the region files of its area, as
+         * generateScenario.py would but without writing or parsing the scenario file. Every region with a population
+         * and a neighbor is a cell with the default state and that population, or the state of infectedCell.json.
+         * The pairs and their correlations come from the correlations file of the area (see precomputeCorrelations.py)
+         *
+         * @param input_dir Directory with default.json and infectedCell.json
+         * @param area_dir Directory with generatorData.json and the CSVs of the area (default: ../cadmium_gis/<area>)
+        */
+        void load_area(string const& input_dir, string area_dir = "")
+        {
+            nlohmann::json const default_cell = read_json(input_dir + "/default.json").at("default");
+            nlohmann::json const infected     = read_json(input_dir + "/infectedCell.json");
+
+            string const area = default_cell.at("area").get<string>();
+            if (area_dir.empty())
+                area_dir = "../cadmium_gis/" + area;
+
+            nlohmann::json const generator_data = read_json(area_dir + "/generatorData.json");
+            string const area_id                = generator_data.at("area_id").get<string>();
+            string const population_column      = generator_data.at("population_column_name").get<string>();
+            string const files                  = area_dir + "/" + area + "_" + to_case(area_id, ::tolower);
+
+            // Regions without a population aren't cells and neither are the pairs they are part of
+            unordered_map<string, double> populations;
+            for (vector<string> const& row : read_csv(files + "_clean.csv", {to_case(area_id, ::toupper), population_column}))
+            {
+                char* end = nullptr;
+                double const population = trunc(strtod(row.at(1).c_str(), &end));
+                if (!row.at(1).empty() && *end == '\0' && !isnan(population) && population != 0)
+                    populations.insert({row.at(0), population});
+                else
+                    populations.insert({row.at(0), 0});
+            }
+
+            string const correlations = files + "_correlations.csv";
+            if (!ifstream{correlations}.is_open())
+                throw runtime_error{"Unable to open the file: " + correlations + " (run Scripts/Input_Generator/precomputeCorrelations.py on the input directory)"};
+
+            // Neighbors of every region, sorted by id like the keys of a parsed scenario file
+            map<string, map<string, double>> adjacency;
+            for (vector<string> const& row : read_csv(correlations, {"region_id", "neighbor_id", "correlation"}))
+            {
+                auto region   = populations.find(row.at(0));
+                auto neighbor = populations.find(row.at(1));
+                AssertLong(region != populations.end(), __FILE__, __LINE__, "The region " + row.at(0) + " of the correlations file isn't in the clean file");
+
+                if (region->second == 0 || (neighbor != populations.end() && neighbor->second == 0))
+                    continue;
+
+                adjacency[row.at(0)][row.at(1)] = stod(row.at(2));
+            }
+
+            nlohmann::json const& default_state = default_cell.at("state");
+            vicinity const default_vicinity     = default_cell.at("neighborhood").at("default_cell_id").get<vicinity>();
+            sevirds const parsed_default_state  = default_state.get<sevirds>();
+
+            cells.clear();
+            configs.clear();
+            cells.reserve(adjacency.size());
+
+            for (auto const& region : adjacency)
+            {
+                scenario_cell cell;
+                cell.cell_id      = region.first;
+                cell.cell_type    = default_cell.at("cell_type").get<string>();
+                cell.delay_id     = default_cell.at("delay").get<string>();
+                cell.config_index = config_index(default_cell.at("config"));
+
+                // Every cell is also its own neighbor, with the default correlation
+                map<string, double> neighbors = region.second;
+                neighbors[region.first]       = default_vicinity.correlation;
+
+                for (auto const& neighbor : neighbors)
+                {
+                    vicinity neighbor_vicinity    = default_vicinity;
+                    neighbor_vicinity.correlation = neighbor.second;
+                    cell.neighborhood.insert({neighbor.first, neighbor_vicinity});
+                }
+
+                if (!infected.contains(region.first))
+                {
+                    cell.state            = parsed_default_state;
+                    cell.state.population = populations.at(region.first);
+                }
+                else
+                {
+                    nlohmann::json state              = default_state;
+                    nlohmann::json const& initial     = infected.at(region.first).at("state");
+                    state["population"]               = populations.at(region.first);
+                    state["susceptible"]              = initial.at("susceptible");
+                    state["exposed"]                  = initial.at("exposed");
+
+                    for (char const* phase : {"infected", "recovered", "fatalities"})
+                    {
+                        if (initial.contains(phase))
+                            state[phase] = initial.at(phase);
+                    }
+                    cell.state = state.get<sevirds>();
+                }
+
+                cells.push_back(move(cell));
+            }
+        }
+
+    private:
+        static nlohmann::json read_json(string const& file_path)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            nlohmann::json json;
+            file >> json;
+            return json;
+        }
+
+        static string to_case(string text, int (*convert)(int))
+        {
+            transform(text.begin(), text.end(), text.begin(), [convert](unsigned char c) { return (char)convert(c); });
+            return text;
+        }
+
+        /**
+         * @brief Reads some columns of a CSV file with a header, whose fields may be quoted
+         *
+         * @param file_path CSV file
+         * @param columns Names of the columns to read, in the order of the values of every row
+         * @return vector<vector<string>> The rows
+        */
+        static vector<vector<string>> read_csv(string const& file_path, vector<string> const& columns)
+        {
+            ifstream file{file_path};
+            if (!file.is_open())
+                throw runtime_error{"Unable to open the file: " + file_path};
+
+            auto split = [](string line)
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+
+                vector<string> fields{""};
+                bool quoted = false;
+                for (unsigned int i = 0; i < line.size(); ++i)
+                {
+                    if (line[i] == '"' && quoted && i + 1 < line.size() && line[i + 1] == '"')
+                        fields.back() += line[++i];
+                    else if (line[i] == '"')
+                        quoted = !quoted;
+                    else if (line[i] == ',' && !quoted)
+                        fields.push_back("");
+                    else
+                        fields.back() += line[i];
+                }
+                return fields;
+            };
+
+            string line;
+            getline(file, line);
+            vector<string> const header = split(line);
+
+            vector<unsigned int> indices;
+            for (string const& column : columns)
+            {
+                auto found = find(header.begin(), header.end(), column);
+                AssertLong(found != header.end(), __FILE__, __LINE__, "The file " + file_path + " has no " + column + " column");
+                indices.push_back(distance(header.begin(), found));
+            }
+
+            vector<vector<string>> rows;
+            while (getline(file, line))
+            {
+                vector<string> const fields = split(line);
+                if (fields.size() == 1 && fields.front().empty())
+                    continue;
+
+                AssertLong(fields.size() == header.size(), __FILE__, __LINE__, "A row of " + file_path + " doesn't have " + to_string(header.size()) + " fields");
+
+                vector<string> row;
+                for (unsigned int index : indices)
+                    row.push_back(fields.at(index));
+                rows.push_back(move(row));
+            }
+            return rows;
+        }
+
+        unsigned int config_index(nlohmann::json const& config)
+        {
+            for (unsigned int i = 0; i < configs.size(); ++i)
+            {
+                if (configs.at(i) == config)
+                    return i;
+            }
+
+            configs.push_back(config);
+            return configs.size() - 1;
+        }
+};
+
+#endif //PANDEMIC_HOYA_2002_SCENARIO_HPP
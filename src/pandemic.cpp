@@ -0,0 +1,268 @@
+// The pandemic-geographical library: the C interface of pandemic.h over the same model as main.cpp
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <cadmium/modeling/dynamic_coupled.hpp>
+#include <cadmium/engine/pdevs_dynamic_runner.hpp>
+#include <cadmium/logger/common_loggers.hpp>
+#include "model/geographical_coupled.hpp"
+#include "pandemic.h"
+
+using namespace std;
+using namespace cadmium;
+using namespace cadmium::celldevs;
+
+using TIME = float;
+
+namespace
+{
+    thread_local string last_error;
+
+    // The state log of the simulation being stepped on the thread, if it asked for one
+    thread_local ostream* state_sink = nullptr;
+
+    struct oss_sink_state { static ostream& sink() { return *state_sink; } };
+
+    using state           = logger::logger<logger::logger_state,       dynamic::logger::formatter<TIME>, oss_sink_state>;
+    using global_time_sta = logger::logger<logger::logger_global_time, dynamic::logger::formatter<TIME>, oss_sink_state>;
+    using logger_states   = logger::multilogger<state, global_time_sta>;
+
+    /**
+     * @brief Runs a call of the interface, turning what it throws into a failure
+     *
+     * @param call The call
+     * @return int 0, or -1 if it threw
+     */
+    int guarded(function<void()> const& call)
+    {
+        try
+        {
+            call();
+            last_error.clear();
+            return 0;
+        }
+        catch (exception const& e)
+        {
+            last_error = e.what();
+        }
+        catch (...)
+        {
+            last_error = "Unknown error";
+        }
+        return -1;
+    }
+} // namespace
+
+struct pandemic_simulation
+{
+    shared_ptr<geographical_coupled<TIME>> model;
+    vector<shared_ptr<geographical_cell<TIME>>> cells;
+    unsigned int day = 0;
+
+    // Set when a step throws: the cells may be left halfway through a day, so nothing but pandemic_destroy() is answered
+    string failure;
+
+    // Created with the first step, with or without the state log
+    function<void(TIME)> run_until;
+    unique_ptr<ofstream> state_log;
+
+    // Random numbers of the simulation, which take the place of those of the thread while it steps (see Random.hpp),
+    // so that simulations sharing a thread don't draw from each other's sequence
+    mt19937 generator;
+
+    pandemic_simulation(scenario const& scenario, unsigned int seed) : generator{seed}
+    {
+        model = make_shared<geographical_coupled<TIME>>("");
+        model->add_cells(scenario);
+        model->couple_cells();
+        cells = model->get_cells();
+    }
+
+    void step(unsigned int days)
+    {
+        swap(generator, Random::engine());
+        state_sink = state_log.get();
+
+        try
+        {
+            if (!run_until)
+            {
+                if (state_log)
+                {
+                    auto r = make_shared<cadmium::dynamic::engine::runner<TIME, logger_states>>(model, TIME{0});
+                    run_until = [r](TIME time) { r->run_until(time); };
+                }
+                else
+                {
+                    auto r = make_shared<cadmium::dynamic::engine::runner<TIME, cadmium::logger::not_logger>>(model, TIME{0});
+                    run_until = [r](TIME time) { r->run_until(time); };
+                }
+            }
+
+            for (unsigned int d = 0; d < days; ++d)
+            {
+                run_until(day + 1);
+                ++day;
+            }
+        }
+        catch (exception const& e)
+        {
+            fail(e.what());
+            throw;
+        }
+        catch (...)
+        {
+            fail("Unknown error");
+            throw;
+        }
+        restore();
+    }
+
+    // Throws if an earlier step failed
+    void check() const
+    {
+        if (!failure.empty())
+            throw runtime_error{"The simulation failed on day " + to_string(day + 1) + " (" + failure + ") and can only be destroyed"};
+    }
+
+    private:
+        void fail(string const& error)
+        {
+            failure = error.empty() ? "Unknown error" : error;
+            restore();
+        }
+
+        void restore()
+        {
+            state_sink = nullptr;
+            swap(generator, Random::engine());
+        }
+};
+
+extern "C"
+{
+
+PANDEMIC_API const char* pandemic_last_error(void)
+{
+    return last_error.c_str();
+}
+
+PANDEMIC_API pandemic_simulation* pandemic_create(const char* scenario_json, size_t length, unsigned int seed)
+{
+    pandemic_simulation* simulation = nullptr;
+    guarded([&]()
+    {
+        scenario parsed;
+        parsed.load(nlohmann::json::parse(scenario_json, scenario_json + length));
+        simulation = new pandemic_simulation(parsed, seed);
+    });
+    return simulation;
+}
+
+PANDEMIC_API pandemic_simulation* pandemic_create_from_file(const char* file_path, unsigned int seed)
+{
+    pandemic_simulation* simulation = nullptr;
+    guarded([&]() { simulation = new pandemic_simulation(scenario{file_path}, seed); });
+    return simulation;
+}
+
+PANDEMIC_API pandemic_simulation* pandemic_create_from_area(const char* input_dir, const char* area_dir, unsigned int seed)
+{
+    pandemic_simulation* simulation = nullptr;
+    guarded([&]()
+    {
+        scenario parsed;
+        parsed.load_area(input_dir, area_dir ? area_dir : "");
+        simulation = new pandemic_simulation(parsed, seed);
+    });
+    return simulation;
+}
+
+PANDEMIC_API int pandemic_log_states(pandemic_simulation* simulation, const char* file_path)
+{
+    return guarded([&]()
+    {
+        simulation->check();
+        if (simulation->run_until)
+            throw runtime_error{"The state log must be asked for before the first step"};
+
+        simulation->state_log = make_unique<ofstream>(file_path);
+        if (!simulation->state_log->is_open())
+            throw runtime_error{"Unable to open the file: " + string{file_path}};
+    });
+}
+
+PANDEMIC_API int pandemic_step(pandemic_simulation* simulation, unsigned int days)
+{
+    return guarded([&]()
+    {
+        simulation->check();
+        simulation->step(days);
+    });
+}
+
+PANDEMIC_API unsigned int pandemic_day(const pandemic_simulation* simulation)
+{
+    return simulation->day;
+}
+
+PANDEMIC_API size_t pandemic_num_cells(const pandemic_simulation* simulation)
+{
+    return simulation->cells.size();
+}
+
+PANDEMIC_API const char* pandemic_cell_id(const pandemic_simulation* simulation, size_t cell)
+{
+    const char* id = nullptr;
+    guarded([&]()
+    {
+        simulation->check();
+        if (cell >= simulation->cells.size())
+            throw runtime_error{"There is no cell " + to_string(cell)};
+        id = simulation->cells[cell]->cell_id.c_str();
+    });
+    return id;
+}
+
+PANDEMIC_API int pandemic_read(const pandemic_simulation* simulation, pandemic_total total, double* values, size_t count)
+{
+    return guarded([&]()
+    {
+        simulation->check();
+        if (count != simulation->cells.size())
+            throw runtime_error{"There are " + to_string(simulation->cells.size()) + " cells, not " + to_string(count)};
+        if (total < PANDEMIC_POPULATION || total > PANDEMIC_DEATHS)
+            throw runtime_error{"Unknown total " + to_string((int)total)};
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            array<double, 11> const fields = log_fields(simulation->cells[i]->state.current_state);
+            values[i] = total == PANDEMIC_POPULATION ? fields[total] : fields[total] * fields[PANDEMIC_POPULATION];
+        }
+    });
+}
+
+PANDEMIC_API int pandemic_modify(pandemic_simulation* simulation, const char* changes, size_t length)
+{
+    return guarded([&]()
+    {
+        simulation->check();
+        nlohmann::json const json = nlohmann::json::parse(changes, changes + length);
+
+        unordered_set<string> cells;
+        if (json.contains("cells"))
+            cells = json.at("cells").get<unordered_set<string>>();
+
+        simulation->model->modify(json.value("config", nlohmann::json::object()), json.value("state", nlohmann::json::object()), cells);
+    });
+}
+
+PANDEMIC_API void pandemic_destroy(pandemic_simulation* simulation)
+{
+    delete simulation;
+}
+
+} // extern "C"
@@ -0,0 +1,96 @@
+/**
+ * C interface of the model, built as the pandemic-geographical library. A simulation is created from a scenario
+ * (the same JSON as the executable reads), stepped some days at a time and read back into arrays of the caller.
+ * Nothing is read or written on disk unless a function taking a file path is called, or the config names files
+ * (ex: a "travel_network").
+ *
+ * Every function returning an int returns 0 on success and -1 on failure, and those returning a pointer return
+ * NULL on failure. pandemic_last_error() then tells what went wrong. A simulation can be used from any thread,
+ * but from only one at a time; different simulations can run side by side on different threads.
+ *
+ * A step that fails (ex: a check of the model) leaves the simulation halfway through a day: every later call on it
+ * then fails, except pandemic_day() and pandemic_num_cells(), which keep answering, and pandemic_destroy().
+ */
+
+#ifndef PANDEMIC_H
+#define PANDEMIC_H
+
+#include <stddef.h>
+
+/* PANDEMIC_BUILDING is only defined while building the library, which exports what its users import */
+#if defined(_WIN32)
+    #ifdef PANDEMIC_BUILDING
+        #define PANDEMIC_API __declspec(dllexport)
+    #else
+        #define PANDEMIC_API __declspec(dllimport)
+    #endif
+#else
+    #define PANDEMIC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pandemic_simulation pandemic_simulation;
+
+/* What pandemic_read() reads of every cell, in the order of the fields of the state log. Every total is in people
+ * except PANDEMIC_POPULATION, and the PANDEMIC_NEW_* are the people who entered the phase on the last day */
+typedef enum pandemic_total
+{
+    PANDEMIC_POPULATION,
+    PANDEMIC_SUSCEPTIBLE,
+    PANDEMIC_EXPOSED,
+    PANDEMIC_VACCINATED_DOSE1,
+    PANDEMIC_VACCINATED_DOSE2,
+    PANDEMIC_INFECTED,
+    PANDEMIC_RECOVERED,
+    PANDEMIC_NEW_EXPOSED,
+    PANDEMIC_NEW_INFECTED,
+    PANDEMIC_NEW_RECOVERED,
+    PANDEMIC_DEATHS
+} pandemic_total;
+
+/* Message of the last failure on the calling thread, or "" */
+PANDEMIC_API const char* pandemic_last_error(void);
+
+/* Creates a simulation from the contents of a scenario file, which don't have to end with a '\0' */
+PANDEMIC_API pandemic_simulation* pandemic_create(const char* scenario, size_t length, unsigned int seed);
+
+/* Creates a simulation from a scenario file */
+PANDEMIC_API pandemic_simulation* pandemic_create_from_file(const char* file_path, unsigned int seed);
+
+/* Creates a simulation from an input directory (default.json and infectedCell.json) and the region files of its area,
+ * as the executable does when given a directory. area_dir can be NULL for ../cadmium_gis/<area> */
+PANDEMIC_API pandemic_simulation* pandemic_create_from_area(const char* input_dir, const char* area_dir, unsigned int seed);
+
+/* Writes the state log of the simulation to a file, as the executable does in logs/pandemic_state.txt.
+ * Only before the first step */
+PANDEMIC_API int pandemic_log_states(pandemic_simulation* simulation, const char* file_path);
+
+/* Runs the next days of the simulation */
+PANDEMIC_API int pandemic_step(pandemic_simulation* simulation, unsigned int days);
+
+/* Number of days run so far, the day that failed excluded */
+PANDEMIC_API unsigned int pandemic_day(const pandemic_simulation* simulation);
+
+/* Number of cells, and the id of each. The cells are in the order the model keeps them, not that of the scenario */
+PANDEMIC_API size_t pandemic_num_cells(const pandemic_simulation* simulation);
+PANDEMIC_API const char* pandemic_cell_id(const pandemic_simulation* simulation, size_t cell);
+
+/* Reads a total of every cell, from its latest state, into values[0 .. count - 1]. count must be pandemic_num_cells() */
+PANDEMIC_API int pandemic_read(const pandemic_simulation* simulation, pandemic_total total, double* values, size_t count);
+
+/* Changes the parameters from the day the next step starts with, as an event of a timeline on that day would:
+ * {"config": {"travel_restriction": "total"}, "state": {"disobedient": 0.2}, "cells": ["ontario_3530"]}.
+ * The "config" is merged over the config of every cell, and the "state" sets the modifiers of the listed cells (every
+ * cell without a list) in the states they compute next. Not available to scenarios with a timeline */
+PANDEMIC_API int pandemic_modify(pandemic_simulation* simulation, const char* changes, size_t length);
+
+PANDEMIC_API void pandemic_destroy(pandemic_simulation* simulation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PANDEMIC_H */